@@ -243,14 +243,18 @@ drmmode_load_cursor_argb (xf86CrtcPtr crtc, CARD32 *image)
     xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(crtc->scrn);
     drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
     xf86CursorInfoPtr cursor_info = xf86_config->cursor_info;
-    uint32_t handle = drmmode_crtc->cursor_bo->handle, *ptr;
+    struct buffer_object *bo;
+    Bool hit;
 
-    /* cursor should be mapped already */
-    ptr = drm_bo_map(crtc->scrn, drmmode_crtc->cursor_bo);
-    memcpy(ptr, image, drmmode_crtc->cursor_bo->size);
+    /* A cached image that is already shown needs no new handle. */
+    bo = viaCursorCacheLoad(crtc, image, &hit);
+    if (hit && (bo == drmmode_crtc->cursor_bo))
+        return;
+
+    drmmode_crtc->cursor_bo = bo;
 
     if (drmModeSetCursor(drmmode_crtc->drmmode->fd, drmmode_crtc->mode_crtc->crtc_id,
-                            handle, cursor_info->MaxWidth, cursor_info->MaxHeight)) {
+                            bo->handle, cursor_info->MaxWidth, cursor_info->MaxHeight)) {
         drmmode_ptr drmmode = drmmode_crtc->drmmode;
 
         cursor_info->MaxWidth = cursor_info->MaxHeight = 0;
@@ -59,6 +59,7 @@ typedef struct {
     drmModeCrtcPtr mode_crtc;
 #endif
     struct buffer_object *cursor_bo;
+    Bool cursor_hi_init;
     unsigned rotate_fb_id;
     int index;
 } drmmode_crtc_private_rec, *drmmode_crtc_private_ptr;
@@ -24,6 +24,8 @@
 #include "via_3d.h"
 #include "via_3d_reg.h"
 #include <picturestr.h>
+#include <stddef.h>
+#include <string.h>
 
 typedef struct
 {
@@ -46,8 +48,8 @@ typedef struct
 static ViaCompositeOperator viaOperatorModes[256];
 static Via3DFormat via3DFormats[256];
 
-#define VIA_NUM_3D_OPCODES 19
-#define VIA_NUM_3D_FORMATS 15
+#define VIA_NUM_3D_OPCODES 20
+#define VIA_NUM_3D_FORMATS 16
 #define VIA_FMT_HASH(arg) (((((arg) >> 1) + (arg)) >> 8) & 0xFF)
 
 static const CARD32 viaOpCodes[VIA_NUM_3D_OPCODES][5] = {
@@ -69,7 +71,8 @@ static const CARD32 viaOpCodes[VIA_NUM_3D_OPCODES][5] = {
     {PictOpDisjointDst, 0x05, 0x55, 0x40, 0x90},
     {PictOpConjointClear, 0x05, 0x45, 0x40, 0x80},
     {PictOpConjointSrc, 0x15, 0x45, 0x50, 0x80},
-    {PictOpConjointDst, 0x05, 0x55, 0x40, 0x90}
+    {PictOpConjointDst, 0x05, 0x55, 0x40, 0x90},
+    {VIA_OP_COMP_OUT_REVERSE, 0x05, 0x50, 0x40, 0x91}
 };
 
 static const CARD32 viaFormats[VIA_NUM_3D_FORMATS][5] = {
@@ -87,7 +90,8 @@ static const CARD32 viaFormats[VIA_NUM_3D_FORMATS][5] = {
     {PICT_a8b8g8r8, HC_HDBFM_ABGR8888, HC_HTXnFM_ABGR8888, 1, 1},
     {PICT_a8, 0x00, HC_HTXnFM_A8, 0, 1},
     {PICT_a4, 0x00, HC_HTXnFM_A4, 0, 1},
-    {PICT_a1, 0x00, HC_HTXnFM_A1, 0, 1}
+    {PICT_a1, 0x00, HC_HTXnFM_A1, 0, 1},
+    {VIA_FMT_A8_INTENSITY, 0x00, HC_HTXnFM_T8, 0, 1}
 };
 
 static CARD32
@@ -166,6 +170,42 @@ viaOrder(CARD32 val, CARD32 * shift)
     return (val == (1 << *shift));
 }
 
+/*
+ * Affine transforms are done by transforming the texture coordinates of
+ * the vertices. Projective transforms would need a texture W per vertex,
+ * and repeating only matches when the texture is the picture itself.
+ * The texture units always wrap, so a transformed picture that does not
+ * repeat would show copies of itself where it should be transparent.
+ * Solid and gradient pictures have no texture to transform.
+ */
+static Bool
+via3DTransformSupported(PicturePtr pPict)
+{
+    PictTransformPtr t = pPict->transform;
+    CARD32 order;
+
+    if (!t)
+        return TRUE;
+
+    if (!pPict->pDrawable)
+        return FALSE;
+
+    if (t->matrix[2][0] || t->matrix[2][1] ||
+        (t->matrix[2][2] != pixman_fixed_1))
+        return FALSE;
+
+    if ((pPict->filter != PictFilterNearest) &&
+        (pPict->filter != PictFilterBilinear))
+        return FALSE;
+
+    if (!pPict->repeat || (pPict->repeatType != RepeatNormal) ||
+        !viaOrder(pPict->pDrawable->width, &order) ||
+        !viaOrder(pPict->pDrawable->height, &order))
+        return FALSE;
+
+    return TRUE;
+}
+
 static Bool
 viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
                 CARD32 pitch, Bool npot, CARD32 width, CARD32 height,
@@ -173,6 +213,13 @@ viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
                 ViaTexBlendingModes blendingMode, Bool agpTexture)
 {
     ViaTextureUnit *vTex = v3d->tex + tex;
+    ViaTextureUnit old = *vTex;
+
+    /*
+     * Stay dirty if any of the checks below fails, since the unit is
+     * then only partly updated.
+     */
+    vTex->textureDirty = TRUE;
 
     vTex->textureLevel0Offset = offset;
     vTex->npot = npot;
@@ -220,15 +267,32 @@ viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
             vTex->texCsat = (0x01 << 23) | (0x03 << 14) | (0x04 << 7) | 0x00;
             vTex->texAsat = (0x01 << 23) | (0x04 << 14) | (0x02 << 7) | 0x03;
             break;
+        case via_comp_mask_alpha:
+            vTex->texCsat = (0x01 << 23) | (0x03 << 14) | (0x08 << 7) | 0x00;
+            vTex->texAsat = (0x01 << 23) | (0x04 << 14) | (0x02 << 7) | 0x03;
+            break;
         default:
             return FALSE;
     }
 
-    vTex->textureDirty = TRUE;
     vTex->textureModesS = sMode - via_single;
     vTex->textureModesT = tMode - via_single;
 
     vTex->agpTexture = agpTexture;
+    vTex->bilinear = FALSE;
+    vTex->transformed = FALSE;
+
+    /*
+     * Rebinding the texture that is already loaded, like a glyph cache
+     * pixmap for every run of glyphs, needs no new texture state.
+     */
+    if (!old.textureDirty) {
+        old.textureDirty = vTex->textureDirty;
+        old.texBColDirty = vTex->texBColDirty;
+        if (!memcmp(&old, vTex, offsetof(ViaTextureUnit, transformed)))
+            vTex->textureDirty = FALSE;
+    }
+
     return TRUE;
 }
 
@@ -248,6 +312,35 @@ viaSet3DTexBlendCol(Via3DState * v3d, int tex, Bool component, CARD32 color)
     vTex->texBColDirty = TRUE;
 }
 
+/*
+ * Map the texture through an affine picture transform. The transform
+ * is applied to the texture coordinates of each vertex.
+ */
+static void
+viaSet3DTexTransform(Via3DState * v3d, int tex, PictTransformPtr transform,
+                     Bool bilinear)
+{
+    ViaTextureUnit *vTex = v3d->tex + tex;
+    int i, j;
+
+    /* Untransformed texels are sampled at their centers anyway. */
+    bilinear = bilinear && (transform != NULL);
+
+    if (vTex->bilinear != bilinear) {
+        vTex->bilinear = bilinear;
+        vTex->textureDirty = TRUE;
+    }
+
+    vTex->transformed = (transform != NULL);
+    if (!transform)
+        return;
+
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < 3; j++)
+            vTex->transform[i][j] =
+                pixman_fixed_to_double(transform->matrix[i][j]);
+}
+
 /*
  * Check if the compositing operator is supported and
  * return the corresponding register setting.
@@ -276,38 +369,123 @@ via3DOpSupported(CARD8 op)
     return viaOperatorModes[op].supported;
 }
 
+/*
+ * Helper for bitdepth expansion.
+ */
+CARD32
+viaBitExpandHelper(CARD32 pixel, CARD32 bits)
+{
+    CARD32 component, mask, tmp;
+
+    component = pixel & ((1 << bits) - 1);
+    mask = (1 << (8 - bits)) - 1;
+    tmp = component << (8 - bits);
+    return ((component & 1) ? (tmp | mask) : tmp);
+}
+
+/*
+ * Extract the components from a pixel of the given format to an argb8888 pixel. * This is used to extract data from one-pixel repeat pixmaps.
+ * Assumes little endian.
+ */
+void
+viaPixelARGB8888(unsigned format, void *pixelP, CARD32 * argb8888)
+{
+    CARD32 bits, shift, pixel, bpp;
+
+    bpp = PICT_FORMAT_BPP(format);
+
+    if (bpp <= 8) {
+        pixel = *((CARD8 *) pixelP);
+    } else if (bpp <= 16) {
+        pixel = *((CARD16 *) pixelP);
+    } else {
+        pixel = *((CARD32 *) pixelP);
+    }
+
+    switch (PICT_FORMAT_TYPE(format)) {
+        case PICT_TYPE_A:
+            bits = PICT_FORMAT_A(format);
+            *argb8888 = viaBitExpandHelper(pixel, bits) << 24;
+            return;
+        case PICT_TYPE_ARGB:
+            shift = 0;
+            bits = PICT_FORMAT_B(format);
+            *argb8888 = viaBitExpandHelper(pixel, bits);
+            shift += bits;
+            bits = PICT_FORMAT_G(format);
+            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits) << 8;
+            shift += bits;
+            bits = PICT_FORMAT_R(format);
+            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits) << 16;
+            shift += bits;
+            bits = PICT_FORMAT_A(format);
+            *argb8888 |= ((bits) ? viaBitExpandHelper(pixel >> shift,
+                                                      bits) : 0xFF) << 24;
+            return;
+        case PICT_TYPE_ABGR:
+            shift = 0;
+            bits = PICT_FORMAT_B(format);
+            *argb8888 = viaBitExpandHelper(pixel, bits) << 16;
+            shift += bits;
+            bits = PICT_FORMAT_G(format);
+            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits) << 8;
+            shift += bits;
+            bits = PICT_FORMAT_R(format);
+            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits);
+            shift += bits;
+            bits = PICT_FORMAT_A(format);
+            *argb8888 |= ((bits) ? viaBitExpandHelper(pixel >> shift,
+                                                      bits) : 0xFF) << 24;
+            return;
+        default:
+            break;
+    }
+    return;
+}
+
 static void
 via3DEmitQuad(VIAPtr pVia,
                 Via3DState * v3d, ViaCommandBuffer * cb, int dstX, int dstY,
                 int src0X, int src0Y, int src1X, int src1Y, int w, int h)
 {
+    /* Two triangles, with the corners numbered as (x2 << 0) | (y2 << 1). */
+    static const int corners[6] = { 0, 1, 2, 2, 1, 3 };
     CARD32 acmd;
-    float dx1, dx2, dy1, dy2, sx1[2], sx2[2], sy1[2], sy2[2], wf;
-    double scalex, scaley;
-    int i, numTex;
+    float dx[4], dy[4], sx[4][VIA_NUM_TEXUNITS], sy[4][VIA_NUM_TEXUNITS], wf;
+    double scalex, scaley, x, y;
+    int srcX[VIA_NUM_TEXUNITS], srcY[VIA_NUM_TEXUNITS];
+    int c, i, v, numTex;
     ViaTextureUnit *vTex;
 
     numTex = v3d->numTextures;
-    dx1 = dstX;
-    dx2 = dstX + w;
-    dy1 = dstY;
-    dy2 = dstY + h;
-
-    if (numTex) {
-        sx1[0] = src0X;
-        sx1[1] = src1X;
-        sy1[0] = src0Y;
-        sy1[1] = src1Y;
-        for (i = 0; i < numTex; ++i) {
-            vTex = v3d->tex + i;
-            scalex = 1. / (double)((1 << vTex->textureLevel0WExp));
-            scaley = 1. / (double)((1 << vTex->textureLevel0HExp));
-            sx2[i] = sx1[i] + w;
-            sy2[i] = sy1[i] + h;
-            sx1[i] *= scalex;
-            sy1[i] *= scaley;
-            sx2[i] *= scalex;
-            sy2[i] *= scaley;
+    srcX[0] = src0X;
+    srcY[0] = src0Y;
+    srcX[1] = src1X;
+    srcY[1] = src1Y;
+
+    for (c = 0; c < 4; ++c) {
+        dx[c] = dstX + ((c & 1) ? w : 0);
+        dy[c] = dstY + ((c & 2) ? h : 0);
+    }
+
+    for (i = 0; i < numTex; ++i) {
+        vTex = v3d->tex + i;
+        scalex = 1. / (double)((1 << vTex->textureLevel0WExp));
+        scaley = 1. / (double)((1 << vTex->textureLevel0HExp));
+        for (c = 0; c < 4; ++c) {
+            x = srcX[i] + ((c & 1) ? w : 0);
+            y = srcY[i] + ((c & 2) ? h : 0);
+            if (vTex->transformed) {
+                double tx = vTex->transform[0][0] * x +
+                            vTex->transform[0][1] * y + vTex->transform[0][2];
+                double ty = vTex->transform[1][0] * x +
+                            vTex->transform[1][1] * y + vTex->transform[1][2];
+
+                x = tx;
+                y = ty;
+            }
+            sx[c][i] = x * scalex;
+            sy[c][i] = y * scaley;
         }
     }
 
@@ -320,7 +498,7 @@ via3DEmitQuad(VIAPtr pVia,
      * a w value after the x and y coordinates.
      */
 
-    BEGIN_H2(HC_ParaType_CmdVdata, 22 + numTex * 6);
+    BEGIN_H2(HC_ParaType_CmdVdata, 22 + numTex * 12);
     acmd = ((1 << 14) | (1 << 13) | (1 << 11));
     if (numTex)
         acmd |= ((1 << 7) | (1 << 8));
@@ -329,65 +507,32 @@ via3DEmitQuad(VIAPtr pVia,
     acmd = 2 << 16;
     OUT_RING_SubA(0xEE, acmd);
 
-    OUT_RING(*((CARD32 *) (&dx1)));
-    OUT_RING(*((CARD32 *) (&dy1)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx1 + i)));
-        OUT_RING(*((CARD32 *) (sy1 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx2)));
-    OUT_RING(*((CARD32 *) (&dy1)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx2 + i)));
-        OUT_RING(*((CARD32 *) (sy1 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx1)));
-    OUT_RING(*((CARD32 *) (&dy2)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx1 + i)));
-        OUT_RING(*((CARD32 *) (sy2 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx1)));
-    OUT_RING(*((CARD32 *) (&dy2)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx1 + i)));
-        OUT_RING(*((CARD32 *) (sy2 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx2)));
-    OUT_RING(*((CARD32 *) (&dy1)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx2 + i)));
-        OUT_RING(*((CARD32 *) (sy1 + i)));
+    for (v = 0; v < 6; ++v) {
+        c = corners[v];
+        OUT_RING(*((CARD32 *) (dx + c)));
+        OUT_RING(*((CARD32 *) (dy + c)));
+        OUT_RING(*((CARD32 *) (&wf)));
+        for (i = 0; i < numTex; ++i) {
+            OUT_RING(*((CARD32 *) (sx[c] + i)));
+            OUT_RING(*((CARD32 *) (sy[c] + i)));
+        }
     }
 
-    OUT_RING(*((CARD32 *) (&dx2)));
-    OUT_RING(*((CARD32 *) (&dy2)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx2 + i)));
-        OUT_RING(*((CARD32 *) (sy2 + i)));
-    }
     OUT_RING_SubA(0xEE,
                   acmd | HC_HPLEND_MASK | HC_HPMValidN_MASK | HC_HE3Fire_MASK);
     OUT_RING_SubA(0xEE,
                   acmd | HC_HPLEND_MASK | HC_HPMValidN_MASK | HC_HE3Fire_MASK);
 
-    ADVANCE_RING;
+    /*
+     * Not flushed here. Quads that follow each other share one vertex
+     * packet, and the caller flushes when the batch is done.
+     */
 }
 
 static void
 via3DEmitState(VIAPtr pVia,
                 Via3DState * v3d, ViaCommandBuffer * cb,
-                Bool forceUpload)
+                CARD32 forceUpload)
 {
     int i;
     Bool saveHas3dState;
@@ -397,7 +542,7 @@ via3DEmitState(VIAPtr pVia,
      * Destination buffer location, format and pitch.
      */
 
-    if (forceUpload || v3d->destDirty) {
+    if ((forceUpload & VIA_3D_STATE_DEST) || v3d->destDirty) {
         v3d->destDirty = FALSE;
         BEGIN_H2(HC_ParaType_NotTex, 3);
 
@@ -407,7 +552,7 @@ via3DEmitState(VIAPtr pVia,
                       (v3d->destPitch & HC_HDBPit_MASK) | HC_HDBLoc_Local);
     }
 
-    if (forceUpload || v3d->blendDirty) {
+    if ((forceUpload & VIA_3D_STATE_BLEND) || v3d->blendDirty) {
         v3d->blendDirty = FALSE;
         BEGIN_H2(HC_ParaType_NotTex, 6);
         OUT_RING_SubA(HC_SubA_HABLRFCa, 0x00);
@@ -418,7 +563,7 @@ via3DEmitState(VIAPtr pVia,
         OUT_RING_SubA(HC_SubA_HABLAop, v3d->blendAl1);
     }
 
-    if (forceUpload || v3d->drawingDirty) {
+    if ((forceUpload & VIA_3D_STATE_DRAWING) || v3d->drawingDirty) {
 
         CARD32 planeMaskLo, planeMaskHi;
 
@@ -452,7 +597,7 @@ via3DEmitState(VIAPtr pVia,
                        | (v3d->solidAlpha & 0xFF)));
     }
 
-    if (forceUpload || v3d->enableDirty) {
+    if ((forceUpload & VIA_3D_STATE_ENABLE) || v3d->enableDirty) {
         v3d->enableDirty = FALSE;
         BEGIN_H2(HC_ParaType_NotTex, 1);
 
@@ -474,7 +619,7 @@ via3DEmitState(VIAPtr pVia,
     for (i = 0; i < v3d->numTextures; ++i) {
         vTex = v3d->tex + i;
 
-        if (forceUpload || vTex->textureDirty) {
+        if ((forceUpload & (VIA_3D_STATE_TEX0 << i)) || vTex->textureDirty) {
             vTex->textureDirty = FALSE;
 
             BEGIN_H2((HC_ParaType_Tex |
@@ -500,7 +645,10 @@ via3DEmitState(VIAPtr pVia,
             OUT_RING_SubA(HC_SubA_HTXnL0_5WE, vTex->textureLevel0WExp);
             OUT_RING_SubA(HC_SubA_HTXnL0_5HE, vTex->textureLevel0HExp);
             OUT_RING_SubA(HC_SubA_HTXnL0OS, 0x00);
-            OUT_RING_SubA(HC_SubA_HTXnTB, 0x00);
+            OUT_RING_SubA(HC_SubA_HTXnTB, (vTex->bilinear)
+                          ? (HC_HTXnFLSe_Linear | HC_HTXnFLSs_Linear |
+                             HC_HTXnFLTe_Linear | HC_HTXnFLTs_Linear)
+                          : 0x00);
             OUT_RING_SubA(HC_SubA_HTXnMPMD,
                           ((((unsigned)vTex->textureModesT) << 19)
                            | (((unsigned)vTex->textureModesS) << 16)));
@@ -517,7 +665,7 @@ via3DEmitState(VIAPtr pVia,
     for (i = 0; i < v3d->numTextures; ++i) {
         vTex = v3d->tex + i;
 
-        if (forceUpload || vTex->texBColDirty) {
+        if ((forceUpload & (VIA_3D_STATE_TEX0 << i)) || vTex->texBColDirty) {
             saveHas3dState = cb->has3dState;
             vTex->texBColDirty = FALSE;
             BEGIN_H2((HC_ParaType_Tex |
@@ -561,6 +709,7 @@ viaInit3DState(Via3DState * v3d)
     v3d->setFlags = viaSet3DFlags;
     v3d->setTexture = viaSet3DTexture;
     v3d->setTexBlendCol = viaSet3DTexBlendCol;
+    v3d->setTexTransform = viaSet3DTexTransform;
     v3d->opSupported = via3DOpSupported;
     v3d->setCompositeOperator = viaSet3DCompositeOperator;
     v3d->emitQuad = via3DEmitQuad;
@@ -568,6 +717,7 @@ viaInit3DState(Via3DState * v3d)
     v3d->emitClipRect = via3DEmitClipRect;
     v3d->dstSupported = via3DDstSupported;
     v3d->texSupported = via3DTexSupported;
+    v3d->transformSupported = via3DTransformSupported;
 
     for (i = 0; i < 256; ++i) {
         viaOperatorModes[i].supported = FALSE;
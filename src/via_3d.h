@@ -26,10 +26,26 @@
 
 #include "xorg-server.h"
 #include "xf86.h"
+#include "picturestr.h"
 #include "via_dmabuffer.h"
 
 #define VIA_NUM_TEXUNITS 2
 
+/* Largest texture and render target clip rectangle, in pixels. */
+#define VIA_3D_MAX_DIM 2048
+
+/*
+ * State groups for emitState. The bits match the VIA_SAREA_3D_* groups
+ * that DRI clients report in the SAREA.
+ */
+#define VIA_3D_STATE_DEST       0x00000001
+#define VIA_3D_STATE_BLEND      0x00000002
+#define VIA_3D_STATE_DRAWING    0x00000004
+#define VIA_3D_STATE_ENABLE     0x00000008
+#define VIA_3D_STATE_TEX0       0x00000010
+#define VIA_3D_STATE_TEX1       0x00000020
+#define VIA_3D_STATE_ALL        0x0000003F
+
 typedef struct _VIA VIARec, *VIAPtr;
 
 typedef enum
@@ -47,9 +63,22 @@ typedef enum
     via_src_onepix_mask,
     via_src_onepix_comp_mask,
     via_mask,
-    via_comp_mask
+    via_comp_mask,
+    via_comp_mask_alpha
 } ViaTexBlendingModes;
 
+/*
+ * Driver-private operator for component-alpha OutReverse, which takes
+ * the per-channel source alpha from the source color.
+ */
+#define VIA_OP_COMP_OUT_REVERSE 0xFF
+
+/*
+ * Driver-private texture format that samples A8 pixels as intensity,
+ * with the alpha value in all four channels.
+ */
+#define VIA_FMT_A8_INTENSITY PICT_FORMAT(8, PICT_TYPE_ARGB, 8, 0, 0, 0)
+
 typedef struct _ViaTextureUnit
 {
     CARD32 textureLevel0Offset;
@@ -68,6 +97,9 @@ typedef struct _ViaTextureUnit
     Bool textureDirty;
     Bool texBColDirty;
     Bool npot;
+    Bool bilinear;
+    Bool transformed;
+    double transform[2][3];
 } ViaTextureUnit;
 
 typedef struct _Via3DState
@@ -106,6 +138,8 @@ typedef struct _Via3DState
         ViaTexBlendingModes blendingMode, Bool agpTexture);
     void (*setTexBlendCol) (struct _Via3DState * v3d, int tex, Bool component,
         CARD32 color);
+    void (*setTexTransform) (struct _Via3DState * v3d, int tex,
+        PictTransformPtr transform, Bool bilinear);
     void (*setCompositeOperator) (struct _Via3DState * v3d, CARD8 op);
         Bool(*opSupported) (CARD8 op);
     void (*emitQuad) (VIAPtr pVia,
@@ -114,12 +148,13 @@ typedef struct _Via3DState
         int w, int h);
     void (*emitState) (VIAPtr pVia,
         struct _Via3DState * v3d, ViaCommandBuffer * cb,
-        Bool forceUpload);
+        CARD32 forceUpload);
     void (*emitClipRect) (VIAPtr pVia,
         struct _Via3DState * v3d, ViaCommandBuffer * cb,
         int x, int y, int w, int h);
     Bool(*dstSupported) (int format);
     Bool(*texSupported) (int format);
+    Bool(*transformSupported) (PicturePtr pPict);
 } Via3DState;
 
 void viaInit3DState(Via3DState * v3d);
@@ -0,0 +1,65 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Layout of the command trace written with Option "CommandTrace", shared
+ * between the driver and tools/via_cmdtrace. All fields are in host byte
+ * order. The file header is followed by one record per flushed command
+ * buffer, each followed by the 32-bit command words as they were sent.
+ */
+
+#ifndef _VIA_CMDTRACE_H_
+#define _VIA_CMDTRACE_H_
+
+#include <stdint.h>
+
+#define VIA_TRACE_MAGIC         0x54434956  /* "VICT" */
+#define VIA_TRACE_VERSION       1
+
+/* Why the buffer was flushed. */
+#define VIA_FLUSH_SUBMIT        0   /* Batch done, or explicit flush. */
+#define VIA_FLUSH_FULL          1   /* No room for the next command. */
+
+/* How the buffer reached the hardware. */
+#define VIA_TRACE_PATH_MMIO     0   /* Register writes by the CPU. */
+#define VIA_TRACE_PATH_AGP      1   /* DRM_VIA_CMDBUFFER. */
+#define VIA_TRACE_PATH_PCI      2   /* DRM_VIA_PCICMD. */
+
+typedef struct _ViaTraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chipset;
+    uint32_t flags;
+} ViaTraceHeader;
+
+/* Header flags. */
+#define VIA_TRACE_2D_M1         0x00000001  /* 2D register layout of VX800+. */
+
+typedef struct _ViaTraceRecord
+{
+    uint64_t usec;          /* Monotonic time of the flush. */
+    uint16_t reason;
+    uint16_t path;
+    uint32_t size;          /* Command words that follow. */
+} ViaTraceRecord;
+
+#endif /* _VIA_CMDTRACE_H_ */
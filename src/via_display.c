@@ -3099,6 +3099,8 @@ via_crtc_dpms(xf86CrtcPtr crtc, int mode)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaRegShadowBegin(pScrn);
+
     if (!iga->index) {
         switch (mode) {
         case DPMSModeOn:
@@ -3127,6 +3129,8 @@ via_crtc_dpms(xf86CrtcPtr crtc, int mode)
         }
     }
 
+    viaRegShadowEnd(pScrn, iga->index ? "IGA2 DPMS" : "IGA1 DPMS");
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -3159,12 +3163,16 @@ via_crtc_restore(xf86CrtcPtr crtc)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaRegShadowBegin(pScrn);
+
     if (!iga->index) {
         viaIGA1Restore(pScrn);
     } else {
         viaIGA2Restore(pScrn);
     }
 
+    viaRegShadowEnd(pScrn, iga->index ? "IGA2 restore" : "IGA1 restore");
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -3286,6 +3294,11 @@ via_crtc_mode_set(xf86CrtcPtr crtc,
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaRegShadowBegin(pScrn);
+
+    /* The HI gets set up again on the next cursor load. */
+    iga->cursor_hi_init = FALSE;
+
     if (!iga->index) {
         /* Put IGA1 into a reset state. */
         viaIGA1HWReset(pScrn, TRUE);
@@ -3347,6 +3360,8 @@ via_crtc_mode_set(xf86CrtcPtr crtc,
         viaIGA2HWReset(pScrn, FALSE);
     }
 
+    viaRegShadowEnd(pScrn, iga->index ? "IGA2 mode set" : "IGA1 mode set");
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -3518,18 +3533,32 @@ via_crtc_load_cursor_argb(xf86CrtcPtr crtc, CARD32 *image)
 {
     ScrnInfoPtr pScrn = crtc->scrn;
     drmmode_crtc_private_ptr iga = crtc->driver_private;
-    void *dst;
+    struct buffer_object *bo;
+    Bool hit;
 
-    dst = drm_bo_map(pScrn, iga->cursor_bo);
-    memcpy(dst, image, iga->cursor_bo->size);
+    bo = viaCursorCacheLoad(crtc, image, &hit);
+
+    /*
+     * The HI registers only need to be set up once per mode set.
+     * After that, switching cursor images only requires pointing
+     * the HI at another cache slot.
+     */
+    if (iga->cursor_hi_init && (iga->cursor_bo == bo))
+        return;
+
+    iga->cursor_bo = bo;
 
     if (!iga->index) {
-        viaIGA1InitHI(pScrn);
+        if (!iga->cursor_hi_init)
+            viaIGA1InitHI(pScrn);
         viaIGA1SetHIStartingAddress(crtc);
     } else {
-        viaIGA2InitHI(pScrn);
+        if (!iga->cursor_hi_init)
+            viaIGA2InitHI(pScrn);
         viaIGA2SetHIStartingAddress(crtc);
     }
+
+    iga->cursor_hi_init = TRUE;
 }
 
 static void
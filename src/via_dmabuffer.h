@@ -25,6 +25,7 @@
 #define VIA_DMABUFFER_H
 
 #include "via_3d_reg.h"
+#include "via_cmdtrace.h"
 
 typedef struct _VIA VIARec, *VIAPtr;
 
@@ -38,6 +39,7 @@ typedef struct _ViaCommandBuffer
     int header_start;
     int rindex;
     Bool has3dState;
+    int flushReason;
     void (*flushFunc) (VIAPtr pVia, struct _ViaCommandBuffer * cb);
 } ViaCommandBuffer;
 
@@ -75,7 +77,8 @@ typedef struct _ViaCommandBuffer
 #define BEGIN_RING(size)                                            \
     do {                                                            \
         if (cb->flushFunc && (cb->pos > (cb->bufSize-(size)))) {    \
-            cb->flushFunc(pVia, cb);                                      \
+            cb->flushReason = VIA_FLUSH_FULL;                       \
+            cb->flushFunc(pVia, cb);                                \
         }                                                           \
     } while(0)
 
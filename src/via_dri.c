@@ -658,6 +658,8 @@ VIADRICloseScreen(ScreenPtr pScreen)
 
     DRICloseScreen(pScreen);
     drm_bo_free(pScrn, pVia->driOffScreenMem);
+    free(pVia->driOffScreenSave);
+    pVia->driOffScreenSave = NULL;
 
     if (pVia->pDRIInfo) {
         if ((pVIADRI = (VIADRIPtr) pVia->pDRIInfo->devPrivate)) {
@@ -862,11 +864,13 @@ VIADRIMapInit(ScreenPtr pScreen, VIAPtr pVia)
 #define DRM_VIA_BLIT_MAX_SIZE (2048*2048*4)
 
 static int
-viaDRIFBMemcpy(int fd, struct buffer_object *vram, unsigned char *addr,
-               Bool toFB)
+viaDRIFBMemcpy(VIAPtr pVia, unsigned long fbOffset, unsigned long size,
+               unsigned char *addr, Bool toFB)
 {
-    unsigned long fbOffset = vram->offset, size = vram->size, curSize;
+    int fd = pVia->drmmode.fd;
+    unsigned long curSize;
     drm_via_dmablit_t blit;
+    CARD64 start;
     int err;
 
     do {
@@ -887,10 +891,12 @@ viaDRIFBMemcpy(int fd, struct buffer_object *vram, unsigned char *addr,
         if (err)
             return err;
 
+        start = viaTimeUsec();
         do {
             err = drmCommandWriteRead(fd, DRM_VIA_BLIT_SYNC,
                                       &blit.sync, sizeof(blit.sync));
         } while (-EAGAIN == err);
+        viaWaitAccount(pVia, VIA_WAIT_DRI_DMA, start, FALSE);
         if (err)
             return err;
 
@@ -902,51 +908,92 @@ viaDRIFBMemcpy(int fd, struct buffer_object *vram, unsigned char *addr,
     return 0;
 }
 
+/*
+ * The DRI offscreen area is allocated from the kernel's heap, which does
+ * not report which parts of it are in use, so all of it is saved.
+ */
 void
 viaDRIOffscreenSave(ScrnInfoPtr pScrn)
 {
     VIAPtr pVia = VIAPTR(pScrn);
-    unsigned long srcSize = pVia->driOffScreenMem->size;
+    unsigned long size = pVia->driOffScreenMem->size;
+    unsigned char *dst, *src;
+    Bool useDMA = (pVia->drmVerMajor == 2) && (pVia->drmVerMinor >= 8);
+    CARD64 startTime = viaTimeUsec();
     int err;
 
-    if (pVia->driOffScreenSave)
-        free(pVia->driOffScreenSave);
-
-    pVia->driOffScreenSave = malloc(srcSize + 16);
     if (pVia->driOffScreenSave) {
-        void *dst, *src = drm_bo_map(pScrn, pVia->driOffScreenMem);
+        free(pVia->driOffScreenSave);
+        pVia->driOffScreenSave = NULL;
+    }
 
-        dst = (void *) ALIGN_TO((unsigned long) pVia->driOffScreenSave, 16);
-        if ((pVia->drmVerMajor == 2) && (pVia->drmVerMinor >= 8)) {
-            err = viaDRIFBMemcpy(pVia->drmmode.fd, pVia->driOffScreenMem, dst, FALSE);
-            if (!err)
-                return;
+    pVia->driOffScreenSave = malloc(size + 16);
+    if (!pVia->driOffScreenSave) {
+        xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+                   "Out of memory trying to backup DRI offscreen memory.\n");
+        return;
+    }
 
+    src = drm_bo_map(pScrn, pVia->driOffScreenMem);
+    dst = (unsigned char *) ALIGN_TO((unsigned long) pVia->driOffScreenSave, 16);
+    if (useDMA) {
+        err = viaDRIFBMemcpy(pVia, pVia->driOffScreenMem->offset,
+                             size, dst, FALSE);
+        if (err) {
             xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
                        "Hardware backup of DRI offscreen memory failed: %s.\n"
                        "\tUsing slow software backup instead.\n",
                        strerror(-err));
+            useDMA = FALSE;
         }
-        memcpy(dst, src, srcSize);
-    } else {
-        xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
-                   "Out of memory trying to backup DRI offscreen memory.\n");
     }
-    return;
+    if (!useDMA)
+        memcpy(dst, src, size);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Saved %lu kB of DRI offscreen memory (%s, %u ms).\n",
+               size >> 10, useDMA ? "DMA" : "CPU",
+               (unsigned) ((viaTimeUsec() - startTime) / 1000));
 }
 
 void
 viaDRIOffscreenRestore(ScrnInfoPtr pScrn)
 {
     VIAPtr pVia = VIAPTR(pScrn);
+    unsigned long size;
+    unsigned char *dst, *src;
+    Bool useDMA;
+    CARD64 startTime;
+    int err;
 
-    if (pVia->driOffScreenSave) {
-        void *src, *dst = drm_bo_map(pScrn, pVia->driOffScreenMem);
+    if (!pVia->driOffScreenSave)
+        return;
 
-        src = pVia->driOffScreenSave;
-        memcpy(dst, src, pVia->driOffScreenMem->size);
-        free(pVia->driOffScreenSave);
-        pVia->driOffScreenSave = NULL;
-    } else {
+    size = pVia->driOffScreenMem->size;
+    useDMA = (pVia->drmVerMajor == 2) && (pVia->drmVerMinor >= 8);
+    startTime = viaTimeUsec();
+
+    dst = drm_bo_map(pScrn, pVia->driOffScreenMem);
+    src = (unsigned char *) ALIGN_TO((unsigned long) pVia->driOffScreenSave, 16);
+    if (useDMA) {
+        err = viaDRIFBMemcpy(pVia, pVia->driOffScreenMem->offset,
+                             size, src, TRUE);
+        if (err) {
+            xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                       "Hardware restore of DRI offscreen memory failed: %s.\n"
+                       "\tUsing slow software restore instead.\n",
+                       strerror(-err));
+            useDMA = FALSE;
+        }
     }
+    if (!useDMA)
+        memcpy(dst, src, size);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Restored %lu kB of DRI offscreen memory (%s, %u ms).\n",
+               size >> 10, useDMA ? "DMA" : "CPU",
+               (unsigned) ((viaTimeUsec() - startTime) / 1000));
+
+    free(pVia->driOffScreenSave);
+    pVia->driOffScreenSave = NULL;
 }
@@ -32,13 +32,42 @@
 #define VIA_MAX_DRAWABLES 256
 
 #define VIA_DRIDDX_VERSION_MAJOR  5
-#define VIA_DRIDDX_VERSION_MINOR  0
+#define VIA_DRIDDX_VERSION_MINOR  1
 #define VIA_DRIDDX_VERSION_PATCH  0
 
 #if !defined(XFree86Server) && !defined(_XDEFS_H)
 typedef int Bool;
 #endif
 
+/*
+ * 3D state tracking in the "dirty" field of the SAREA private record.
+ * The low bits are the state groups that were changed since the X server
+ * last owned the 3D engine, the middle bits the low bits of the context
+ * that last updated the field.
+ *
+ * A context that takes over the engine (writes ctxOwner) and supports
+ * tracking keeps the groups already set if the field is tagged
+ * with the previous owner, or sets all groups otherwise. It then tags
+ * the field with its own context, and adds the groups it changes while
+ * it owns the engine. A field not tagged with the current owner makes
+ * the X server re-emit all 3D state.
+ */
+#define VIA_SAREA_3D_DEST           0x00000001
+#define VIA_SAREA_3D_BLEND          0x00000002
+#define VIA_SAREA_3D_DRAWING        0x00000004
+#define VIA_SAREA_3D_ENABLE         0x00000008
+#define VIA_SAREA_3D_TEX0           0x00000010
+#define VIA_SAREA_3D_TEX1           0x00000020
+#define VIA_SAREA_3D_ALL            0x0000003F
+#define VIA_SAREA_3D_OWNER_SHIFT    8
+#define VIA_SAREA_3D_OWNER_MASK     0x7FFFFF00
+#define VIA_SAREA_3D_TRACKED        0x80000000
+
+#define VIA_SAREA_3D_TAG(context) \
+    (VIA_SAREA_3D_TRACKED | \
+     (((unsigned)(context) << VIA_SAREA_3D_OWNER_SHIFT) & \
+      VIA_SAREA_3D_OWNER_MASK))
+
 typedef struct {
     drm_handle_t handle;
     drmSize size;
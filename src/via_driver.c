@@ -269,12 +269,18 @@ VIAEnterVT_internal(ScrnInfoPtr pScrn, int flags)
         }
     }
 
+    /* Cursor images have to be reloaded by the mode set below. */
+    viaCursorCacheInvalidate(pScrn);
+
     if (!xf86SetDesiredModes(pScrn)) {
         DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                             "Exiting %s.\n", __func__));
         return FALSE;
     }
 
+    /* The 3D engine state may have been changed while switched away. */
+    pVia->lastToUpload = NULL;
+
     if (!flags) {
         /* Restore video status. */
         if ((!pVia->IsSecondary) && (!pVia->KMS)) {
@@ -631,6 +637,227 @@ VIAGetRec(ScrnInfoPtr pScrn)
     return ret;
 } /* VIAGetRec */
 
+/*
+ * Starts a new startup timing window.  Phases recorded with
+ * viaBootPhaseEnd() are measured from the previous mark.
+ */
+void
+viaBootPhaseStart(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    pVia->numBootPhases = 0;
+    pVia->bootPhaseTotal = 0;
+    pVia->bootPhaseMark = viaTimeUsec();
+}
+
+void
+viaBootPhaseEnd(ScrnInfoPtr pScrn, const char *name)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 now = viaTimeUsec();
+    CARD32 elapsed = now - pVia->bootPhaseMark;
+
+    pVia->bootPhaseMark = now;
+    pVia->bootPhaseTotal += elapsed;
+
+    if (pVia->numBootPhases < VIA_BOOT_PHASE_MAX) {
+        pVia->bootPhase[pVia->numBootPhases].name = name;
+        pVia->bootPhase[pVia->numBootPhases].usec = elapsed;
+        pVia->numBootPhases++;
+    }
+}
+
+/*
+ * Prints the phases recorded since viaBootPhaseStart() and
+ * resets the table.
+ */
+void
+viaBootPhaseReport(ScrnInfoPtr pScrn, const char *stage)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    int i;
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                "%s took %u.%03u ms.\n", stage,
+                (unsigned) (pVia->bootPhaseTotal / 1000),
+                (unsigned) (pVia->bootPhaseTotal % 1000));
+
+    for (i = 0; i < pVia->numBootPhases; i++) {
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+                        "    %-24s %6u.%03u ms\n",
+                        pVia->bootPhase[i].name,
+                        pVia->bootPhase[i].usec / 1000,
+                        pVia->bootPhase[i].usec % 1000);
+    }
+
+    viaBootPhaseStart(pScrn);
+}
+
+/*
+ * Each cursor cache slot holds one ARGB cursor image in video memory,
+ * plus a system memory copy to confirm hash matches.  Showing an image
+ * that is still cached only requires pointing the hardware at its slot.
+ */
+static CARD32
+viaCursorHash(CARD32 *image, int size)
+{
+    CARD32 hash = 2166136261U;
+    int i;
+
+    for (i = 0; i < size / 4; i++) {
+        hash ^= image[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+Bool
+viaCursorCacheInit(ScrnInfoPtr pScrn, int size, int alignment)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIACursorSlotRec *slot;
+    int i;
+
+    for (i = 0; i < VIA_CURSOR_CACHE_SLOTS; i++) {
+        slot = &pVia->cursorCache[i];
+
+        slot->bo = drm_bo_alloc(pScrn, size, alignment, TTM_PL_VRAM);
+        if (!slot->bo)
+            break;
+
+        slot->image = malloc(size);
+        if (!slot->image) {
+            drm_bo_free(pScrn, slot->bo);
+            slot->bo = NULL;
+            break;
+        }
+
+        slot->hash = 0;
+        slot->lastUse = 0;
+        slot->valid = FALSE;
+    }
+
+    pVia->cursorSize = size;
+    pVia->numCursorSlots = i;
+    pVia->cursorCacheAge = 0;
+
+    if (!pVia->numCursorSlots)
+        return FALSE;
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                "Caching up to %d hardware cursor images.\n",
+                pVia->numCursorSlots);
+    return TRUE;
+}
+
+void
+viaCursorCacheFini(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIACursorSlotRec *slot;
+    int i;
+
+    for (i = 0; i < pVia->numCursorSlots; i++) {
+        slot = &pVia->cursorCache[i];
+
+        drm_bo_free(pScrn, slot->bo);
+        slot->bo = NULL;
+        free(slot->image);
+        slot->image = NULL;
+        slot->valid = FALSE;
+    }
+
+    pVia->numCursorSlots = 0;
+}
+
+/*
+ * The cursor storage lives in video memory, which is not preserved
+ * while switched away, so every cached image has to be reloaded.
+ */
+void
+viaCursorCacheInvalidate(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    int i;
+
+    for (i = 0; i < pVia->numCursorSlots; i++)
+        pVia->cursorCache[i].valid = FALSE;
+}
+
+/*
+ * Returns TRUE if a CRTC other than the given one is scanning out
+ * its cursor from this buffer.
+ */
+static Bool
+viaCursorSlotShown(xf86CrtcPtr crtc, struct buffer_object *bo)
+{
+    xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(crtc->scrn);
+    drmmode_crtc_private_ptr iga;
+    int i;
+
+    for (i = 0; i < xf86_config->num_crtc; i++) {
+        if (xf86_config->crtc[i] == crtc)
+            continue;
+
+        iga = xf86_config->crtc[i]->driver_private;
+        if (iga && (iga->cursor_bo == bo))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Returns the cursor storage holding the given image.  On a miss, the
+ * least recently used slot is overwritten, skipping slots another CRTC
+ * is currently showing unless no other slot is left.
+ */
+struct buffer_object *
+viaCursorCacheLoad(xf86CrtcPtr crtc, CARD32 *image, Bool *hit)
+{
+    ScrnInfoPtr pScrn = crtc->scrn;
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIACursorSlotRec *slot, *victim = NULL;
+    CARD32 hash = viaCursorHash(image, pVia->cursorSize);
+    Bool victimShown = FALSE, shown;
+    int i;
+
+    pVia->cursorCacheAge++;
+
+    for (i = 0; i < pVia->numCursorSlots; i++) {
+        slot = &pVia->cursorCache[i];
+
+        if (slot->valid && (slot->hash == hash) &&
+            !memcmp(slot->image, image, pVia->cursorSize)) {
+            slot->lastUse = pVia->cursorCacheAge;
+            *hit = TRUE;
+            return slot->bo;
+        }
+
+        shown = viaCursorSlotShown(crtc, slot->bo);
+        if (!victim || (victimShown && !shown) ||
+            ((victimShown == shown) &&
+             (!slot->valid ||
+              (victim->valid && (slot->lastUse < victim->lastUse))))) {
+            victim = slot;
+            victimShown = shown;
+        }
+    }
+
+    if (!victim->bo->ptr)
+        drm_bo_map(pScrn, victim->bo);
+    memcpy(victim->bo->ptr, image, pVia->cursorSize);
+    memcpy(victim->image, image, pVia->cursorSize);
+    victim->hash = hash;
+    victim->lastUse = pVia->cursorCacheAge;
+    victim->valid = TRUE;
+
+    *hit = FALSE;
+    return victim->bo;
+}
+
 static unsigned int
 viaConvertDepthToBpp(int bpp, int depth)
 {
@@ -683,6 +910,26 @@ viaConvertDepthToBpp(int bpp, int depth)
     return bppSize;
 }
 
+/*
+ * Move the rows of a reused buffer to a new pitch. A wider pitch moves
+ * every row down, so the rows are moved from the bottom up; a narrower
+ * one moves them up, so they are moved from the top down.
+ */
+static void
+viaRepitchRows(CARD8 *base, unsigned oldPitch, unsigned newPitch,
+                unsigned rowBytes, int rows)
+{
+    int i;
+
+    if (newPitch > oldPitch) {
+        for (i = rows - 1; i > 0; i--)
+            memmove(base + i * newPitch, base + i * oldPitch, rowBytes);
+    } else if (newPitch < oldPitch) {
+        for (i = 1; i < rows; i++)
+            memmove(base + i * newPitch, base + i * oldPitch, rowBytes);
+    }
+}
+
 Bool
 via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
 {
@@ -702,6 +949,8 @@ via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
     VIAPtr pVia = VIAPTR(scrn);
     xf86CrtcPtr crtc = NULL;
     unsigned int bppSize, alignedPitch;
+    int copy_width, copy_height;
+    Bool in_place = FALSE;
 
     DEBUG(xf86DrvMsg(scrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
@@ -727,12 +976,22 @@ via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
                                         scrn->depth);
     alignedPitch = width * bppSize;
     alignedPitch = ALIGN_TO(alignedPitch, 16);
-    drmmode->front_bo = drm_bo_alloc(scrn,
-                                        alignedPitch * height,
-                                        16, TTM_PL_VRAM);
-    if (!drmmode->front_bo) {
-        goto fail;
+
+    /*
+     * Keep the current front buffer when the new screen fits into it,
+     * which is always the case when MaxFrontBuffer reserved enough.
+     */
+    if (old_front && (alignedPitch * height <= old_front->size)) {
+        in_place = TRUE;
+    } else {
+        drmmode->front_bo = drm_bo_alloc(scrn,
+                                            alignedPitch * height,
+                                            16, TTM_PL_VRAM);
+        if (!drmmode->front_bo) {
+            goto fail;
+        }
     }
+
     scrn->virtualX = width;
     scrn->virtualY = height;
     scrn->displayWidth = width;
@@ -754,23 +1013,80 @@ via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
         goto fail;
     }
 
+    copy_width = (width < old_width) ? width : old_width;
+    copy_height = (height < old_height) ? height : old_height;
+
+    /*
+     * A reused front buffer keeps its contents, but they are laid out
+     * for the old pitch. Wait for the engine to finish drawing into it
+     * and move the rows that stay visible.
+     */
+    if (in_place) {
+        if (!pVia->NoAccel && pVia->useEXA)
+            viaAccelSync(scrn);
+        viaRepitchRows(new_pixels, old_displayWidth * cpp, width * cpp,
+                        copy_width * cpp, copy_height);
+    }
+
     if (pVia->shadowFB) {
-        new_pixels = malloc(scrn->displayWidth * scrn->virtualY *
-                            ((scrn->bitsPerPixel + 7) >> 3));
-        if (!new_pixels) {
-            goto fail;
+        unsigned long shadow_size = scrn->displayWidth * scrn->virtualY *
+                                    ((scrn->bitsPerPixel + 7) >> 3);
+
+        if (shadow_size <= pVia->ShadowSize) {
+            new_pixels = pVia->ShadowPtr;
+            viaRepitchRows(new_pixels, old_displayWidth * cpp, width * cpp,
+                            copy_width * cpp, copy_height);
+        } else {
+            new_pixels = malloc(shadow_size);
+            if (!new_pixels) {
+                goto fail;
+            }
+
+            /* Preserve the part of the screen that stays visible. */
+            for (i = 0; i < copy_height; i++) {
+                memcpy((CARD8 *) new_pixels + i * width * cpp,
+                        pVia->ShadowPtr + i * old_displayWidth * cpp,
+                        copy_width * cpp);
+            }
+
+            free(pVia->ShadowPtr);
+            pVia->ShadowPtr = new_pixels;
+            pVia->ShadowSize = shadow_size;
         }
+    } else if (!in_place) {
+        unsigned old_pitch = old_displayWidth * cpp;
+        unsigned new_pitch = width * cpp;
 
-        free(pVia->ShadowPtr);
-        pVia->ShadowPtr = new_pixels;
+        /*
+         * Preserve the part of the screen that stays visible, so it
+         * does not have to wait for a full repaint.
+         */
+        if (!pVia->NoAccel && pVia->useEXA &&
+            !(old_pitch & 7) && !(new_pitch & 7)) {
+            viaAccelFBCopy(scrn, old_front->offset, old_pitch,
+                            drmmode->front_bo->offset, new_pitch,
+                            copy_width, copy_height);
+        } else if (drm_bo_map(scrn, old_front)) {
+            for (i = 0; i < copy_height; i++) {
+                memcpy((CARD8 *) new_pixels + i * new_pitch,
+                        (CARD8 *) old_front->ptr + i * old_pitch,
+                        copy_width * cpp);
+            }
+        }
     }
 
     screen->ModifyPixmapHeader(ppix, width, height, -1, -1,
                                 width * cpp, new_pixels);
 
-    xf86DrvMsg(scrn->scrnIndex, X_INFO,
-                "Allocated a new frame buffer: %dx%d\n",
-                width, height);
+    if (in_place) {
+        xf86DrvMsg(scrn->scrnIndex, X_INFO,
+                    "Reusing the frame buffer for %dx%d\n",
+                    width, height);
+    } else {
+        xf86DrvMsg(scrn->scrnIndex, X_INFO,
+                    "Allocated a new frame buffer: %dx%d\n",
+                    width, height);
+    }
 
 
 #if XORG_VERSION_CURRENT < XORG_VERSION_NUMERIC(1,9,99,1,0)
@@ -802,7 +1118,7 @@ via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
     }
 #endif
 
-    if (old_fb_id) {
+    if (old_front && (old_front != drmmode->front_bo)) {
         drm_bo_free(scrn, old_front);
     }
 
@@ -813,7 +1129,7 @@ via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
     return TRUE;
 
 fail:
-    if (drmmode->front_bo) {
+    if (drmmode->front_bo && (drmmode->front_bo != old_front)) {
         drm_bo_free(scrn, drmmode->front_bo);
     }
 
@@ -1021,6 +1337,8 @@ VIAPreInit(ScrnInfoPtr pScrn, int flags)
     }
 
     pVia = VIAPTR(pScrn);
+    viaBootPhaseStart(pScrn);
+
     pVia->IsSecondary = FALSE;
     pEnt = xf86GetEntityInfo(pScrn->entityList[0]);
 #ifndef XSERVER_LIBPCIACCESS
@@ -1117,12 +1435,16 @@ VIAPreInit(ScrnInfoPtr pScrn, int flags)
 
     xf86DrvMsg(pScrn->scrnIndex, from, "Chipset revision: %d\n", pVia->ChipRev);
 
+    viaBootPhaseEnd(pScrn, "Chipset detection");
+
     pVia->directRenderingType = DRI_NONE;
     pVia->KMS = FALSE;
 #ifdef OPENCHROMEDRI
     if (!viaDrmOpen(pScrn)) {
         goto free_rec;
     }
+
+    viaBootPhaseEnd(pScrn, "DRM open");
 #endif /* OPENCHROMEDRI */
 
     option = xf86NewOption(strEXAOptionName, strEXAValue);
@@ -1134,10 +1456,14 @@ VIAPreInit(ScrnInfoPtr pScrn, int flags)
 
     VIAVidHWDiffInit(pScrn);
 
+    viaBootPhaseEnd(pScrn, "Option processing");
+
     if (pVia->KMS) {
         if (!drmmode_pre_init(pScrn, &pVia->drmmode)) {
             goto free_rec;
         }
+
+        viaBootPhaseEnd(pScrn, "KMS PreInit");
     } else {
         /*
          * After viaUMSPreInit() succeeds, MMIO PCI hardware resources
@@ -1184,6 +1510,8 @@ VIAPreInit(ScrnInfoPtr pScrn, int flags)
         }
     }
 
+    viaBootPhaseEnd(pScrn, "Module loading");
+
     /*
      * Set up screen parameters.
      */
@@ -1193,6 +1521,8 @@ VIAPreInit(ScrnInfoPtr pScrn, int flags)
         viaUMSPreInitExit(pScrn);
     }
 
+    viaBootPhaseReport(pScrn, "PreInit");
+
     status = TRUE;
     goto exit;
 fail:
@@ -1201,6 +1531,7 @@ fail:
     }
 
 free_rec:
+    viaBootPhaseReport(pScrn, "Failed PreInit");
     VIAFreeRec(pScrn);
 exit:
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
@@ -1327,19 +1658,6 @@ static Bool
 VIACloseScreen(CLOSE_SCREEN_ARGS_DECL)
 {
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
-    xf86CrtcConfigPtr   xf86_config = XF86_CRTC_CONFIG_PTR(pScrn);
-
-    /*
-     * Since there is now only one location for the allocated
-     * hardware cursor storage, the code needs access to one of the
-     * two CRTC structs for obtaining pointer address to the hardware
-     * cursor storage.  In this case, IGA1's CRTC struct happens to
-     * be selected, but IGA2's CRTC struct can very well supply the
-     * same information.
-     */
-    xf86CrtcPtr crtc = xf86_config->crtc[0];
-    drmmode_crtc_private_ptr iga = crtc->driver_private;
-
     VIAPtr pVia = VIAPTR(pScrn);
 
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO, "VIACloseScreen\n"));
@@ -1350,6 +1668,8 @@ VIACloseScreen(CLOSE_SCREEN_ARGS_DECL)
     }
 #endif /* OPENCHROMEDRI */
 
+    viaEngineLoadStop(pScrn);
+
     if (pVia->directRenderingType != DRI_2)
         viaExitVideo(pScrn);
 
@@ -1361,6 +1681,7 @@ VIACloseScreen(CLOSE_SCREEN_ARGS_DECL)
         shadowRemove(pScreen, pScreen->GetScreenPixmap(pScreen));
         free(pVia->ShadowPtr);
         pVia->ShadowPtr = NULL;
+        pVia->ShadowSize = 0;
     }
 
     /* Is the display currently visible? */
@@ -1377,13 +1698,13 @@ VIACloseScreen(CLOSE_SCREEN_ARGS_DECL)
         pVia->drmmode.fb_id = 0;
 
         drm_bo_free(pScrn, pVia->drmmode.front_bo);
+        pVia->drmmode.front_bo = NULL;
     }
 
-    if (iga->cursor_bo)
-        /*
-         * Release hardware cursor storage.
-         */
-        drm_bo_free(pScrn, iga->cursor_bo);
+    /*
+     * Release hardware cursor storage.
+     */
+    viaCursorCacheFini(pScrn);
 
 #ifdef OPENCHROMEDRI
     if (pVia->directRenderingType == DRI_1)
@@ -1414,9 +1735,9 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
     unsigned int bppSize, alignedPitch;
     unsigned long alignment;
     xf86CrtcConfigPtr xf86_config;
-    struct buffer_object *bo;
     int cursorWidth, cursorHeight, flags;
     int cursorSize;
+    unsigned long frontSize;
     int i;
 
     pScrn->displayWidth = pScrn->virtualX;
@@ -1426,6 +1747,8 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
 
     pScrn->pScreen = pScreen;
 
+    viaBootPhaseStart(pScrn);
+
     miClearVisualTypes();
 
     if (!miSetVisualTypes(pScrn->depth,
@@ -1445,6 +1768,7 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
         pVia->shadowFB = FALSE;
         pVia->ShadowPtr = malloc(pitch * pScrn->virtualY);
         if (pVia->ShadowPtr) {
+            pVia->ShadowSize = pitch * pScrn->virtualY;
             if (shadowSetup(pScreen))
                 pVia->shadowFB = TRUE;
         }
@@ -1474,6 +1798,8 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
     /* Must be after RGB ordering is fixed. */
     fbPictureInit(pScreen, NULL, 0);
 
+    viaBootPhaseEnd(pScrn, "fb initialization");
+
     if (!pVia->KMS) {
         if (!viaUMSMapIOResources(pScrn)) {
             return FALSE;
@@ -1511,6 +1837,8 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
         }
     }
 
+    viaBootPhaseEnd(pScrn, "DRI / UMS ScreenInit");
+
     if ((!pVia->NoAccel) &&
         ((pVia->directRenderingType == DRI_NONE)
 #ifdef OPENCHROMEDRI
@@ -1520,6 +1848,8 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
         if (!viaUMSAccelInit(pScrn)) {
             return FALSE;
         }
+
+        viaBootPhaseEnd(pScrn, "Acceleration setup");
     }
 
     xf86SetBackingStore(pScreen);
@@ -1553,9 +1883,7 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
         /*
          * Set cursor location in frame buffer.
          */
-        bo = drm_bo_alloc(pScrn, cursorSize, alignment,
-                            TTM_PL_VRAM);
-        if (!bo) {
+        if (!viaCursorCacheInit(pScrn, cursorSize, alignment)) {
             return FALSE;
         }
 
@@ -1566,7 +1894,8 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
             /*
              * Set cursor location in frame buffer.
              */
-            iga->cursor_bo = bo;
+            iga->cursor_bo = pVia->cursorCache[0].bo;
+            iga->cursor_hi_init = FALSE;
         }
 
         if (!xf86_cursors_init(pScreen,
@@ -1581,10 +1910,26 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
                                         pScrn->depth);
     alignedPitch = pScrn->virtualX * bppSize;
     alignedPitch = ALIGN_TO(alignedPitch, 16);
-    pVia->drmmode.front_bo = drm_bo_alloc(pScrn,
-                                            alignedPitch *
-                                            pScrn->virtualY,
-                                            16, TTM_PL_VRAM);
+    frontSize = alignedPitch * pScrn->virtualY;
+
+    if (pVia->maxFrontWidth && pVia->maxFrontHeight) {
+        unsigned long reserveSize =
+                ALIGN_TO(pVia->maxFrontWidth * bppSize, 16) *
+                pVia->maxFrontHeight;
+
+        if (reserveSize > frontSize) {
+            pVia->drmmode.front_bo = drm_bo_alloc(pScrn, reserveSize,
+                                                    16, TTM_PL_VRAM);
+            if (!pVia->drmmode.front_bo)
+                xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                            "Could not reserve a %dx%d front buffer.\n",
+                            pVia->maxFrontWidth, pVia->maxFrontHeight);
+        }
+    }
+
+    if (!pVia->drmmode.front_bo)
+        pVia->drmmode.front_bo = drm_bo_alloc(pScrn, frontSize,
+                                                16, TTM_PL_VRAM);
     if (!pVia->drmmode.front_bo)
         return FALSE;
 
@@ -1611,9 +1956,13 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
 
     xf86DPMSInit(pScreen, xf86DPMSSet, 0);
 
+    viaBootPhaseEnd(pScrn, "Cursor and frame buffer");
+
     if (!VIAEnterVT_internal(pScrn, 1))
         return FALSE;
 
+    viaBootPhaseEnd(pScrn, "Initial mode set");
+
     if (pVia->directRenderingType != DRI_2) {
 #ifdef OPENCHROMEDRI
         if (pVia->directRenderingType == DRI_1) {
@@ -1630,8 +1979,13 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
             viaFinishInitAccel(pScreen);
 
         viaInitVideo(pScrn->pScreen);
+        viaBootPhaseEnd(pScrn, "Acceleration and video");
     }
 
+    viaEngineLoadStart(pScrn);
+
+    viaBootPhaseReport(pScrn, "ScreenInit");
+
     if (serverGeneration == 1)
         xf86ShowUnusedOptions(pScrn->scrnIndex, pScrn->options);
 
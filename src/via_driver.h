@@ -54,6 +54,9 @@
 #include <pciaccess.h>
 #endif
 
+#include <stdio.h>
+#include <time.h>
+
 #include "compat-api.h"
 
 #include "drmmode_display.h"
@@ -189,6 +192,111 @@ typedef struct {
 
 #endif
 
+/*
+ * Startup phase timing.
+ */
+#define VIA_BOOT_PHASE_MAX  24
+
+typedef struct _VIABootPhase {
+    const char *name;
+    CARD32      usec;
+} VIABootPhaseRec;
+
+/*
+ * Hardware cursor image cache.
+ */
+#define VIA_CURSOR_CACHE_SLOTS  8
+
+typedef struct _VIACursorSlot {
+    struct buffer_object *bo;
+    CARD32     *image;
+    CARD32      hash;
+    CARD32      lastUse;
+    Bool        valid;
+} VIACursorSlotRec;
+
+/* Reasons for not accelerating a composite operation. */
+typedef enum {
+    VIA_REJECT_SRC_DRAWABLE,
+    VIA_REJECT_SRC_SMALL,
+    VIA_REJECT_MASK_SMALL,
+    VIA_REJECT_REPEAT,
+    VIA_REJECT_TOO_LARGE,
+    VIA_REJECT_TRANSFORM,
+    VIA_REJECT_COMPONENT_ALPHA,
+    VIA_REJECT_OPERATOR,
+    VIA_REJECT_DST_FORMAT,
+    VIA_REJECT_MASK_FORMAT,
+    VIA_REJECT_SRC_FORMAT,
+    VIA_REJECT_PREPARE,
+    VIA_NUM_REJECTS
+} VIACompositeReject;
+
+#define VIA_COMPOSITE_STAT_SLOTS    64
+
+typedef struct _VIACompositeStat {
+    CARD32      srcFormat;
+    CARD32      maskFormat;
+    CARD32      dstFormat;
+    CARD8       op;
+    CARD8       reason;
+    unsigned long count;
+} VIACompositeStatRec;
+
+typedef struct _VIACompositeStats {
+    unsigned long accelOps;
+    unsigned long accelPixels;
+    unsigned long fallbackOps;
+    unsigned long fallbackPixels;
+    unsigned long rejects[VIA_NUM_REJECTS];
+    /* Rejects by operator and formats, with the overflow counted. */
+    VIACompositeStatRec slots[VIA_COMPOSITE_STAT_SLOTS];
+    unsigned long unrecorded;
+    Atom        atom;
+    OsTimerPtr  timer;
+    unsigned long publishedOps;     /* Operations when last published. */
+    Bool        quiet;              /* Rejects are not counted. */
+} VIACompositeStatsRec;
+
+/* Places where the driver waits for the graphics engines. */
+typedef enum {
+    VIA_WAIT_IDLE,          /* viaAccelSync: all engines. */
+    VIA_WAIT_MARKER,        /* viaAccelWaitMarker: marker blit. */
+    VIA_WAIT_QUEUE,         /* viaFlushPCI: command regulator and 2D. */
+    VIA_WAIT_DMA,           /* viaAccelDMADownload: PCI DMA blit. */
+    VIA_WAIT_XV_DMA,        /* viaDmaBlitImage: Xv frame upload. */
+    VIA_WAIT_DRI_DMA,       /* viaDRIFBMemcpy: DRI buffer save/restore. */
+    VIA_NUM_WAITS
+} VIAWaitSite;
+
+typedef struct _VIAWaitStat {
+    unsigned long waits;
+    unsigned long timeouts;
+    CARD64      usec;
+    CARD64      maxUsec;
+} VIAWaitStatRec;
+
+/* Engines sampled for Option "EngineLoad", see via_engload.c. */
+enum {
+    VIA_ENGINE_2D,
+    VIA_ENGINE_3D,
+    VIA_ENGINE_CMD,
+    VIA_ENGINE_HQV,
+    VIA_ENGINE_MPEG,
+    VIA_NUM_ENGINES
+};
+
+typedef struct _VIAEngineLoad {
+    OsTimerPtr  timer;
+    Atom        atom;
+    CARD32      period;             /* Publishing period in ms. */
+    CARD32      lastPublished;
+    CARD32      seed;
+    unsigned long samples;
+    unsigned long busy[VIA_NUM_ENGINES];
+    Bool        idle;               /* Sampling at the idle rate. */
+} VIAEngineLoadRec;
+
 typedef struct _twodContext {
     CARD32 mode;
     CARD32 cmd;
@@ -256,6 +364,7 @@ typedef struct _VIA {
 
     /* Support for shadowFB and rotation */
     unsigned char*      ShadowPtr;
+    unsigned long       ShadowSize;
 
     /* Support for EXA acceleration */
     ViaTwodContext      td;
@@ -281,14 +390,35 @@ typedef struct _VIA {
     Bool                componentAlpha;
     void               *srcP;
     CARD32              srcFormat;
+    CARD32              dstFormat;
+    Bool                compositeFill;
     unsigned            scratchOffset;
     int                 exaScratchSize;
     char *              scratchAddr;
+    int                 scratchMarker;
     Bool                noComposite;
     struct buffer_object *scratchBuffer;
+
+    /* Sizes below which EXA operations are left to the CPU. */
+    unsigned            minComposite;
+    unsigned            minTexUpload;
+    unsigned            minDownload;
+    Bool                exaCalibrate;
+    const char         *exaCalibrationCache;
+    CompositeProcPtr    savedComposite;
+
+    /* Command trace, see via_cmdtrace.h. */
+    const char         *cmdTraceFile;
+    FILE               *cmdTrace;
 #ifdef OPENCHROMEDRI
     struct buffer_object *texAGPBuffer;
     char *              dBounce;
+
+#ifdef HAVE_PTHREAD
+    /* Command buffer submission from a separate thread. */
+    struct _VIASubmitQueue *submitQueue;
+    ScreenBlockHandlerProcPtr savedBlockHandler;
+#endif
 #endif
 
     /* Rotation */
@@ -328,6 +458,7 @@ typedef struct _VIA {
     Bool                agpEnable;
     Bool                dma2d;
     Bool                dmaXV;
+    Bool                asyncSubmit;
 
     /* Video */
     int                 VideoEngine;
@@ -354,10 +485,51 @@ typedef struct _VIA {
 #endif /* HAVE_DEBUG */
 
     video_via_regs*     VideoRegs;
+
+    /* Startup phase timing. */
+    CARD64              bootPhaseMark;
+    CARD64              bootPhaseTotal;
+    int                 numBootPhases;
+    VIABootPhaseRec     bootPhase[VIA_BOOT_PHASE_MAX];
+
+    /* Front buffer size reserved for RandR resizes. */
+    int                 maxFrontWidth;
+    int                 maxFrontHeight;
+
+    /* Hardware cursor image cache. */
+    int                 cursorSize;
+    int                 numCursorSlots;
+    CARD32              cursorCacheAge;
+    VIACursorSlotRec    cursorCache[VIA_CURSOR_CACHE_SLOTS];
+
+    /* Composite acceleration statistics. */
+    VIACompositeStatsRec compStats;
+
+    /* Command buffers flushed by viaFlushPCI. */
+    unsigned long       mmioFlushes;
+
+    /* Time spent waiting for the engines. */
+    VIAWaitStatRec      waitStats[VIA_NUM_WAITS];
+
+    /* Engine load sampling, in seconds between reports. */
+    int                 engineLoadPeriod;
+    VIAEngineLoadRec    engineLoad;
 } VIARec, *VIAPtr;
 
 #define VIAPTR(p) ((VIAPtr)((p)->driverPrivate))
 
+/*
+ * Monotonic time stamp in microseconds.
+ */
+static inline CARD64
+viaTimeUsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((CARD64) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
 typedef struct
 {
     Bool IsDRIEnabled;
@@ -378,6 +550,14 @@ const OptionInfoRec *VIAAvailableOptions(int chipid, int busid);
 void viaSetupDefaultOptions(ScrnInfoPtr pScrn);
 void viaProcessOptions(ScrnInfoPtr pScrn);
 Bool via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height);
+void viaBootPhaseStart(ScrnInfoPtr pScrn);
+void viaBootPhaseEnd(ScrnInfoPtr pScrn, const char *name);
+void viaBootPhaseReport(ScrnInfoPtr pScrn, const char *stage);
+Bool viaCursorCacheInit(ScrnInfoPtr pScrn, int size, int alignment);
+void viaCursorCacheFini(ScrnInfoPtr pScrn);
+void viaCursorCacheInvalidate(ScrnInfoPtr pScrn);
+struct buffer_object *viaCursorCacheLoad(xf86CrtcPtr crtc, CARD32 *image,
+                                            Bool *hit);
 
 /* In via_exa.c. */
 int viaEXAOffscreenAlloc(ScrnInfoPtr pScrn,
@@ -391,13 +571,32 @@ Bool viaAccelSetMode(int bpp, ViaTwodContext * tdc);
 void viaSetClippingRectangle(ScrnInfoPtr pScrn,
                                 int x1, int y1, int x2, int y2);
 void viaAccelSync(ScrnInfoPtr);
+void viaWaitAccount(VIAPtr pVia, VIAWaitSite site, CARD64 start,
+                    Bool timedOut);
+void viaSubmitWait(VIAPtr pVia);
+void viaAccelFBCopy(ScrnInfoPtr pScrn, unsigned long srcOffset,
+                    unsigned srcPitch, unsigned long dstOffset,
+                    unsigned dstPitch, int width, int height);
 void viaExitAccel(ScreenPtr);
 void viaFinishInitAccel(ScreenPtr);
 Bool viaOrder(CARD32 val, CARD32 * shift);
 CARD32 viaBitExpandHelper(CARD32 pixel, CARD32 bits);
-Bool viaCheckUpload(ScrnInfoPtr pScrn, Via3DState * v3d);
+CARD32 viaCheckUpload(ScrnInfoPtr pScrn, Via3DState * v3d);
 void viaPixelARGB8888(unsigned format, void *pixelP, CARD32 * argb8888);
 Bool viaExpandablePixel(int format);
+Bool viaExaCheckCompositeA8(int op, PicturePtr pSrcPicture,
+                            PicturePtr pMaskPicture, PicturePtr pDstPicture);
+void viaExaCompositeA8(PixmapPtr pDst, int srcX, int srcY, int maskX,
+                        int maskY, int dstX, int dstY, int width, int height);
+void viaExaCompositeReject(VIAPtr pVia, int reason, CARD8 op,
+                            PicturePtr pSrc, PicturePtr pMask,
+                            PicturePtr pDst);
+Bool viaExaCompositeFillColor(CARD8 op, PicturePtr pSrcPicture,
+                                void *srcP, PicturePtr pDstPicture,
+                                Pixel *fg);
+void viaExaCompositeTiled(PixmapPtr pDst, int srcX, int srcY,
+                            int maskX, int maskY, int dstX, int dstY,
+                            int width, int height);
 void viaAccelFillPixmap(ScrnInfoPtr, unsigned long, unsigned long,
 			int, int, int, int, int, unsigned long);
 void viaAccelTextureBlit(ScrnInfoPtr, unsigned long, unsigned, unsigned,
@@ -427,7 +626,11 @@ Bool viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
 void viaExaComposite_H2(PixmapPtr pDst, int srcX, int srcY,
                         int maskX, int maskY, int dstX, int dstY,
                         int width, int height);
+void viaExaDoneComposite_H2(PixmapPtr pDst);
 int viaAccelMarkSync_H2(ScreenPtr);
+void viaAccelFBCopy_H2(ScrnInfoPtr pScrn, unsigned long srcOffset,
+                        unsigned srcPitch, unsigned long dstOffset,
+                        unsigned dstPitch, int width, int height);
 
 /* In via_exa_h6.c */
 Bool viaExaPrepareSolid_H6(PixmapPtr pPixmap, int alu, Pixel planeMask,
@@ -446,7 +649,11 @@ Bool viaExaPrepareComposite_H6(int op, PicturePtr pSrcPicture,
 void viaExaComposite_H6(PixmapPtr pDst, int srcX, int srcY,
                         int maskX, int maskY, int dstX, int dstY,
                         int width, int height);
+void viaExaDoneComposite_H6(PixmapPtr pDst);
 int viaAccelMarkSync_H6(ScreenPtr);
+void viaAccelFBCopy_H6(ScrnInfoPtr pScrn, unsigned long srcOffset,
+                        unsigned srcPitch, unsigned long dstOffset,
+                        unsigned dstPitch, int width, int height);
 
 /* In via_xv.c */
 void viaInitVideo(ScreenPtr pScreen);
@@ -465,6 +672,10 @@ typedef void (*vidCopyFunc)(unsigned char *, const unsigned char *,
                             int, int, int, int);
 extern vidCopyFunc viaVidCopyInit(const char *copyType, ScreenPtr pScreen );
 
+/* In via_engload.c */
+void viaEngineLoadStart(ScrnInfoPtr pScrn);
+void viaEngineLoadStop(ScrnInfoPtr pScrn);
+
 /* In via_xwmc.c */
 
 #ifdef OPENCHROMEDRI
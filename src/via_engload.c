@@ -0,0 +1,199 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Engine load sampling for Option "EngineLoad". A timer reads the busy
+ * bits of the 2D and 3D engines, the command regulator, the HQV video
+ * processor and the MPEG decoder about ten times a second, and the busy
+ * percentages are published as the VIA_ENGINE_LOAD property of the root
+ * window, where "xprop -root VIA_ENGINE_LOAD" shows them.
+ *
+ * After a publishing period in which no engine was seen busy, samples
+ * are taken only once a second, so that an idle server is not woken up
+ * for nothing. The first busy sample returns to the normal rate. The
+ * timer is not stopped altogether, since DRI clients use the engines
+ * without going through the server.
+ *
+ * Timers run from the server's main loop, so samples are not taken while
+ * the server itself is busy; the figures are a cheap estimate, not a
+ * measurement.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "via_driver.h"
+#include "via_regs.h"
+#include "via_eng_regs.h"
+#include "property.h"
+#include <X11/Xatom.h>
+
+/* Sampling interval in ms, varied by up to this jitter either way. */
+#define VIA_LOAD_SAMPLE_MS      100
+#define VIA_LOAD_JITTER_MS      30
+
+/* Sampling interval in ms while the engines are idle. */
+#define VIA_LOAD_IDLE_MS        1000
+
+/* MPEG decoder status, as read by the XvMC library. */
+#define VIA_MPEG_BUSY_MASK      0x00000207
+#define VIA_MPEG_IDLE           0x00000204
+#define VIA_MPEG_ERROR          0x00000070
+
+static const char *viaEngineNames[VIA_NUM_ENGINES] = {
+    "2d", "3d", "cmd", "hqv", "mpeg"
+};
+
+static void
+viaEngineLoadPublish(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIAEngineLoadRec *load = &pVia->engineLoad;
+    ScreenPtr pScreen = xf86ScrnToScreen(pScrn);
+    char buf[128];
+    int i, len = 0;
+
+    for (i = 0; i < VIA_NUM_ENGINES; i++)
+        len += snprintf(buf + len, sizeof(buf) - len, "%s %lu%% ",
+                        viaEngineNames[i],
+                        load->busy[i] * 100 / load->samples);
+    len += snprintf(buf + len, sizeof(buf) - len, "(%lu samples)",
+                    load->samples);
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 4, "Engine load: %s\n", buf);
+
+    if (!pScreen->root)
+        return;
+
+    dixChangeWindowProperty(serverClient, pScreen->root, load->atom,
+                            XA_STRING, 8, PropModeReplace, len, buf, TRUE);
+}
+
+static CARD32
+viaEngineLoadSample(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    ScrnInfoPtr pScrn = arg;
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIAEngineLoadRec *load = &pVia->engineLoad;
+    CARD32 status;
+    unsigned long busy = 0;
+    int i;
+#ifdef OPENCHROMEDRI
+    CARD32 mpeg;
+#endif
+
+    /*
+     * A fixed interval could lock onto the refresh rate, or to a client
+     * drawing once a frame.
+     */
+    load->seed = load->seed * 1103515245 + 12345;
+
+    if (!pScrn->vtSema)
+        goto out;
+
+    status = VIAGETREG(VIA_REG_STATUS);
+    switch (pVia->Chipset) {
+    case VIA_VX800:
+    case VIA_VX855:
+    case VIA_VX900:
+        load->busy[VIA_ENGINE_2D] += !!(status & VIA_2D_ENG_BUSY_H5);
+        load->busy[VIA_ENGINE_3D] += !!(status & VIA_3D_ENG_BUSY_H5);
+        load->busy[VIA_ENGINE_CMD] += !!(status & VIA_CMD_RGTR_BUSY_H5);
+        break;
+    default:
+        load->busy[VIA_ENGINE_2D] += !!(status & VIA_2D_ENG_BUSY);
+        load->busy[VIA_ENGINE_3D] += !!(status & VIA_3D_ENG_BUSY);
+        load->busy[VIA_ENGINE_CMD] += !!(status & VIA_CMD_RGTR_BUSY);
+        break;
+    }
+
+    status = VIAGETREG(HQV_CONTROL);
+    load->busy[VIA_ENGINE_HQV] += ((status & HQV_ENABLE) &&
+                                   !(status & HQV_IDLE));
+
+#ifdef OPENCHROMEDRI
+    if (pVia->XvMCEnabled) {
+        mpeg = MPGInD(MPG_STATUS);
+        load->busy[VIA_ENGINE_MPEG] += (!(mpeg & VIA_MPEG_ERROR) &&
+                                        ((mpeg & VIA_MPEG_BUSY_MASK) !=
+                                         VIA_MPEG_IDLE));
+    }
+#endif
+    load->samples++;
+
+    for (i = 0; i < VIA_NUM_ENGINES; i++)
+        busy += load->busy[i];
+    if (busy)
+        load->idle = FALSE;
+
+    if ((now - load->lastPublished) >= load->period && load->samples) {
+        viaEngineLoadPublish(pScrn);
+        memset(load->busy, 0, sizeof(load->busy));
+        load->samples = 0;
+        load->lastPublished = now;
+        load->idle = !busy;
+    }
+
+out:
+    if (load->idle || !pScrn->vtSema)
+        return VIA_LOAD_IDLE_MS;
+    return (VIA_LOAD_SAMPLE_MS - VIA_LOAD_JITTER_MS +
+            (load->seed >> 16) % (2 * VIA_LOAD_JITTER_MS + 1));
+}
+
+void
+viaEngineLoadStart(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIAEngineLoadRec *load = &pVia->engineLoad;
+
+    if (!pVia->engineLoadPeriod || pVia->KMS)
+        return;
+
+    memset(load, 0, sizeof(*load));
+    /* Atoms do not survive a server regeneration. */
+    load->atom = MakeAtom("VIA_ENGINE_LOAD", sizeof("VIA_ENGINE_LOAD") - 1,
+                          TRUE);
+    load->period = pVia->engineLoadPeriod * 1000;
+    load->lastPublished = GetTimeInMillis();
+    load->seed = load->lastPublished;
+    load->timer = TimerSet(NULL, 0, VIA_LOAD_SAMPLE_MS,
+                           viaEngineLoadSample, pScrn);
+    if (!load->timer)
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Could not start engine load sampling.\n");
+}
+
+void
+viaEngineLoadStop(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIAEngineLoadRec *load = &pVia->engineLoad;
+
+    if (load->timer) {
+        TimerFree(load->timer);
+        load->timer = NULL;
+    }
+}
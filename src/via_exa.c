@@ -34,25 +34,219 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pixman.h>
+#if defined(OPENCHROMEDRI) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#include <signal.h>
+#endif
 
 #include "via_driver.h"
 #include "via_regs.h"
 #include "via_dmabuffer.h"
+#include "via_probes.h"
+#include "mipict.h"
+#include "property.h"
+#include <X11/Xatom.h>
+
+/*
+ * Append a command buffer that is about to be sent to the command trace.
+ */
+static void
+viaTraceCommands(VIAPtr pVia, ViaCommandBuffer *cb, int path)
+{
+    ViaTraceRecord rec;
+
+    if (pVia->cmdTrace) {
+        rec.usec = viaTimeUsec();
+        rec.reason = cb->flushReason;
+        rec.path = path;
+        rec.size = cb->pos;
+        if ((fwrite(&rec, sizeof(rec), 1, pVia->cmdTrace) != 1) ||
+            (fwrite(cb->buf, sizeof(CARD32), cb->pos,
+                    pVia->cmdTrace) != cb->pos)) {
+            ErrorF("Command trace write failed. Tracing stopped.\n");
+            fclose(pVia->cmdTrace);
+            pVia->cmdTrace = NULL;
+        }
+    }
+    cb->flushReason = VIA_FLUSH_SUBMIT;
+}
 
+static void
+viaOpenCommandTrace(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaTraceHeader header;
+
+    pVia->cmdTrace = fopen(pVia->cmdTraceFile, "wb");
+    if (!pVia->cmdTrace) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Could not open command trace %s: %s\n",
+                   pVia->cmdTraceFile, strerror(errno));
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = VIA_TRACE_MAGIC;
+    header.version = VIA_TRACE_VERSION;
+    header.chipset = pVia->Chipset;
+    switch (pVia->Chipset) {
+    case VIA_VX800:
+    case VIA_VX855:
+    case VIA_VX900:
+        header.flags |= VIA_TRACE_2D_M1;
+        break;
+    default:
+        break;
+    }
+    if (fwrite(&header, sizeof(header), 1, pVia->cmdTrace) != 1) {
+        fclose(pVia->cmdTrace);
+        pVia->cmdTrace = NULL;
+    }
+}
+
+/*
+ * Waits for the engines spin first, which is cheapest for short ones,
+ * then give the CPU to other processes, and finally sleep. The phases
+ * are timed rather than counted, so that they do not depend on the speed
+ * of the CPU or of register reads.
+ */
+#define VIA_WAIT_SPIN_USEC      50
+#define VIA_WAIT_YIELD_USEC     2000
+#define VIA_WAIT_SLEEP_USEC     200
+#define VIA_WAIT_TIMEOUT_USEC   5000000
+
+static const char *viaWaitNames[VIA_NUM_WAITS] = {
+    "engine idle", "marker", "command queue", "DMA download",
+    "Xv DMA upload", "DRI buffer DMA"
+};
+
+typedef Bool (*viaWaitDoneProc) (VIAPtr pVia, CARD32 arg);
+
+/*
+ * Account for a wait that started at the given time. A timeout is also
+ * logged right away, since it means an engine is probably hung.
+ */
+void
+viaWaitAccount(VIAPtr pVia, VIAWaitSite site, CARD64 start, Bool timedOut)
+{
+    VIAWaitStatRec *stat = &pVia->waitStats[site];
+    CARD64 usec = viaTimeUsec() - start;
+
+    stat->waits++;
+    stat->usec += usec;
+    if (usec > stat->maxUsec)
+        stat->maxUsec = usec;
+    if (timedOut) {
+        stat->timeouts++;
+        ErrorF("Timed out waiting for %s after %u ms (%lu timeouts).\n",
+               viaWaitNames[site], (unsigned) (usec / 1000),
+               stat->timeouts);
+    }
+}
+
+/*
+ * Wait until done() returns TRUE, and account for the time if it did not
+ * right away.
+ */
+static void
+viaWaitFor(VIAPtr pVia, VIAWaitSite site, viaWaitDoneProc done, CARD32 arg)
+{
+    CARD64 start, elapsed;
+
+    if (done(pVia, arg))
+        return;
+
+    start = viaTimeUsec();
+    while (!done(pVia, arg)) {
+        elapsed = viaTimeUsec() - start;
+        if (elapsed > VIA_WAIT_TIMEOUT_USEC) {
+            viaWaitAccount(pVia, site, start, TRUE);
+            return;
+        }
+        if (elapsed > VIA_WAIT_YIELD_USEC)
+            usleep(VIA_WAIT_SLEEP_USEC);
+        else if (elapsed > VIA_WAIT_SPIN_USEC)
+            sched_yield();
+    }
+    viaWaitAccount(pVia, site, start, FALSE);
+}
+
+/*
+ * Status bits of the command regulator and the 2D engine, and optionally
+ * of the 3D engine.
+ */
+static CARD32
+viaEngineBusyMask(VIAPtr pVia, Bool with3D)
+{
+    switch (pVia->Chipset) {
+    case VIA_VX800:
+    case VIA_VX855:
+    case VIA_VX900:
+        return (VIA_CMD_RGTR_BUSY_H5 | VIA_2D_ENG_BUSY_H5 |
+                ((with3D) ? VIA_3D_ENG_BUSY_H5 : 0));
+    default:
+        return (VIA_CMD_RGTR_BUSY | VIA_2D_ENG_BUSY |
+                ((with3D) ? VIA_3D_ENG_BUSY : 0));
+    }
+}
+
+static Bool
+viaEngineIdle(VIAPtr pVia, CARD32 busyMask)
+{
+    CARD32 status = VIAGETREG(VIA_REG_STATUS);
+
+    switch (pVia->Chipset) {
+    case VIA_VX800:
+    case VIA_VX855:
+    case VIA_VX900:
+    case VIA_P4M890:
+    case VIA_K8M890:
+    case VIA_P4M900:
+        return !(status & busyMask);
+    default:
+        return ((status & VIA_VR_QUEUE_EMPTY) && !(status & busyMask));
+    }
+}
+
+static Bool
+viaMarkerPassed(VIAPtr pVia, CARD32 marker)
+{
+    pVia->lastMarkerRead = *(volatile CARD32 *) pVia->markerBuf;
+    return ((pVia->lastMarkerRead - marker) <= (1 << 24));
+}
+
+/*
+ * Write the command buffer to the engine registers. Header-2 data goes
+ * through the command regulator's queue. Header-1 writes go straight to
+ * the 2D engine registers, and the virtual queue does not handle them
+ * (see viaEnableAGPVQ), so the engine has to be idle before each 2D
+ * command, or the new register values would change the running blit.
+ */
 static void
 viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb)
 {
     register CARD32 *bp = cb->buf;
     CARD32 transSetting;
     CARD32 *endp = bp + cb->pos;
-    unsigned loop = 0;
     register CARD32 offset = 0;
     register CARD32 value;
 
+    VIA_PROBE3(flush__start, VIA_TRACE_PATH_MMIO, cb->pos, cb->flushReason);
+    viaTraceCommands(pVia, cb, VIA_TRACE_PATH_MMIO);
+    pVia->mmioFlushes++;
+
     while (bp < endp) {
         if (*bp == HALCYON_HEADER2) {
-            if (++bp == endp)
+            if (++bp == endp) {
+                VIA_PROBE1(flush__done, VIA_TRACE_PATH_MMIO);
                 return;
+            }
             VIASETREG(VIA_REG_TRANSET, transSetting = *bp++);
             while (bp < endp) {
                 if ((transSetting != HC_ParaType_CmdVdata)
@@ -72,30 +266,8 @@ viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb)
                      * for an unacceptable amount of time in VIASETREG while
                      * other high priority interrupts may be pending.
                      */
-                    switch (pVia->Chipset) {
-                    case VIA_VX800:
-                    case VIA_VX855:
-                    case VIA_VX900:
-                        while ((VIAGETREG(VIA_REG_STATUS) &
-                                (VIA_CMD_RGTR_BUSY_H5 | VIA_2D_ENG_BUSY_H5)) &&
-                                (loop++ < MAXLOOP)) ;
-                        break;
-
-                    case VIA_P4M890:
-                    case VIA_K8M890:
-                    case VIA_P4M900:
-                        while ((VIAGETREG(VIA_REG_STATUS) &
-                                (VIA_CMD_RGTR_BUSY | VIA_2D_ENG_BUSY)) &&
-                                (loop++ < MAXLOOP)) ;
-                        break;
-
-                    default:
-                        while (!(VIAGETREG(VIA_REG_STATUS) & VIA_VR_QUEUE_EMPTY) &&
-                                (loop++ < MAXLOOP)) ;
-                        while ((VIAGETREG(VIA_REG_STATUS) &
-                                (VIA_CMD_RGTR_BUSY | VIA_2D_ENG_BUSY)) &&
-                                (loop++ < MAXLOOP)) ;
-                    }
+                    viaWaitFor(pVia, VIA_WAIT_QUEUE, viaEngineIdle,
+                               viaEngineBusyMask(pVia, FALSE));
                 }
                 offset = (*bp++ & 0x0FFFFFFF) << 2;
                 value = *bp++;
@@ -108,6 +280,7 @@ viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb)
     cb->pos = 0;
     cb->mode = 0;
     cb->has3dState = FALSE;
+    VIA_PROBE1(flush__done, VIA_TRACE_PATH_MMIO);
 }
 
 #ifdef OPENCHROMEDRI
@@ -129,6 +302,226 @@ viaDumpDMA(ViaCommandBuffer *cb)
     ErrorF("\n");
 }
 
+/*
+ * Hand command words to the DRM, in pieces the command verifier accepts.
+ */
+static int
+viaSubmitDRM(int fd, unsigned long request, CARD32 *buf, unsigned pos)
+{
+    char *tmp = (char *)buf;
+    int tmpSize = pos * sizeof(CARD32);
+    drm_via_cmdbuffer_t b;
+
+    while (tmpSize > 0) {
+        b.size = (tmpSize > VIA_DMASIZE) ? VIA_DMASIZE : tmpSize;
+        tmpSize -= b.size;
+        b.buf = tmp;
+        tmp += b.size;
+        if (drmCommandWrite(fd, request, &b, sizeof(b)))
+            return -1;
+    }
+    return 0;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * With Option "AsyncSubmit", a second thread makes the DRM calls, which
+ * may wait for room in the ring buffer, while the server goes on filling
+ * the other one of two command buffers. The thread owns the buffer in
+ * 'buf' while 'busy' is set; otherwise that buffer is the spare.
+ */
+typedef struct _VIASubmitQueue {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int fd;
+    CARD32 *buf;
+    unsigned pos;
+    unsigned long request;
+    Bool busy;
+    Bool failed;
+    Bool quit;
+} VIASubmitQueueRec, *VIASubmitQueuePtr;
+
+static void *
+viaSubmitThread(void *arg)
+{
+    VIASubmitQueuePtr q = arg;
+    Bool failed;
+
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        while (!q->busy && !q->quit)
+            pthread_cond_wait(&q->cond, &q->lock);
+        if (!q->busy)
+            break;
+        pthread_mutex_unlock(&q->lock);
+
+        failed = (viaSubmitDRM(q->fd, q->request, q->buf, q->pos) != 0);
+
+        pthread_mutex_lock(&q->lock);
+        q->failed = failed;
+        q->busy = FALSE;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+/*
+ * Wait until the submission thread has handed its buffer to the DRM.
+ * Needed before waiting for the engine, before writing to it directly,
+ * and before the DRI lock is released.
+ */
+void
+viaSubmitWait(VIAPtr pVia)
+{
+    VIASubmitQueuePtr q = pVia->submitQueue;
+    ViaCommandBuffer failedCb;
+    Bool failed;
+
+    if (!q)
+        return;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->busy)
+        pthread_cond_wait(&q->cond, &q->lock);
+    failed = q->failed;
+    q->failed = FALSE;
+    pthread_mutex_unlock(&q->lock);
+
+    if (failed) {
+        ErrorF("DRM command buffer submission failed.\n");
+        failedCb.buf = q->buf;
+        failedCb.pos = q->pos;
+        viaDumpDMA(&failedCb);
+    }
+}
+
+/*
+ * Pass the command buffer to the submission thread, and continue with
+ * the spare buffer.
+ */
+static void
+viaSubmitQueue(VIAPtr pVia, ViaCommandBuffer *cb, unsigned long request)
+{
+    VIASubmitQueuePtr q = pVia->submitQueue;
+    CARD32 *buf = cb->buf;
+
+    viaSubmitWait(pVia);
+
+    pthread_mutex_lock(&q->lock);
+    cb->buf = q->buf;
+    q->buf = buf;
+    q->pos = cb->pos;
+    q->request = request;
+    q->busy = TRUE;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    cb->pos = 0;
+}
+
+static void
+viaSubmitBlockHandler(BLOCKHANDLER_ARGS_DECL)
+{
+    SCREEN_PTR(arg);
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    viaSubmitWait(pVia);
+
+    pScreen->BlockHandler = pVia->savedBlockHandler;
+    (*pScreen->BlockHandler) (BLOCKHANDLER_ARGS);
+    pScreen->BlockHandler = viaSubmitBlockHandler;
+}
+
+static void
+viaStartSubmitThread(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIASubmitQueuePtr q;
+    sigset_t sigs, oldSigs;
+    int ret;
+
+    q = calloc(1, sizeof(*q));
+    if (!q)
+        return;
+    q->buf = calloc(pVia->cb.bufSize, sizeof(CARD32));
+    q->fd = pVia->drmmode.fd;
+    if (!q->buf)
+        goto err_free;
+    if (pthread_mutex_init(&q->lock, NULL))
+        goto err_free;
+    if (pthread_cond_init(&q->cond, NULL))
+        goto err_mutex;
+
+    /* Leave the server's signals to the main thread. */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, &oldSigs);
+    ret = pthread_create(&q->thread, NULL, viaSubmitThread, q);
+    pthread_sigmask(SIG_SETMASK, &oldSigs, NULL);
+    if (ret)
+        goto err_cond;
+
+    pVia->submitQueue = q;
+
+    /*
+     * Screen block handlers run before the DRI block handler, which
+     * releases the DRI lock that command submission requires.
+     */
+    pVia->savedBlockHandler = pScreen->BlockHandler;
+    pScreen->BlockHandler = viaSubmitBlockHandler;
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Submitting command buffers from a separate thread.\n");
+    return;
+
+err_cond:
+    pthread_cond_destroy(&q->cond);
+err_mutex:
+    pthread_mutex_destroy(&q->lock);
+err_free:
+    free(q->buf);
+    free(q);
+    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+               "Could not start the command submission thread.\n");
+}
+
+static void
+viaStopSubmitThread(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIASubmitQueuePtr q = pVia->submitQueue;
+
+    if (!q)
+        return;
+
+    viaSubmitWait(pVia);
+    if (pScreen->BlockHandler == viaSubmitBlockHandler)
+        pScreen->BlockHandler = pVia->savedBlockHandler;
+
+    pthread_mutex_lock(&q->lock);
+    q->quit = TRUE;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(q->thread, NULL);
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    free(q->buf);
+    free(q);
+    pVia->submitQueue = NULL;
+}
+#else
+void
+viaSubmitWait(VIAPtr pVia)
+{
+}
+#endif /* HAVE_PTHREAD */
+
 /*
  * Flush the command buffer using DRM. If in PCI mode, we can bypass DRM,
  * but not for command buffers that contain 3D engine state, since then
@@ -137,9 +530,8 @@ viaDumpDMA(ViaCommandBuffer *cb)
 static void
 viaFlushDRIEnabled(VIAPtr pVia, ViaCommandBuffer *cb)
 {
-    char *tmp = (char *)cb->buf;
-    int tmpSize;
-    drm_via_cmdbuffer_t b;
+    unsigned long request = (pVia->agpDMA) ? DRM_VIA_CMDBUFFER
+                                           : DRM_VIA_PCICMD;
 
     /* Align end of command buffer for AGP DMA. */
     OUT_RING_H1(0x2f8, 0x67676767);
@@ -148,28 +540,38 @@ viaFlushDRIEnabled(VIAPtr pVia, ViaCommandBuffer *cb)
         OUT_RING(HC_DUMMY);
     }
 
-    tmpSize = cb->pos * sizeof(CARD32);
     if (pVia->agpDMA || (pVia->directRenderingType && cb->has3dState)) {
+        int path = (pVia->agpDMA) ? VIA_TRACE_PATH_AGP : VIA_TRACE_PATH_PCI;
+
+        VIA_PROBE3(flush__start, path, cb->pos, cb->flushReason);
+        viaTraceCommands(pVia, cb, path);
         cb->mode = 0;
         cb->has3dState = FALSE;
-        while (tmpSize > 0) {
-            b.size = (tmpSize > VIA_DMASIZE) ? VIA_DMASIZE : tmpSize;
-            tmpSize -= b.size;
-            b.buf = tmp;
-            tmp += b.size;
-            if (drmCommandWrite(pVia->drmmode.fd, ((pVia->agpDMA)
-                                              ? DRM_VIA_CMDBUFFER :
-                                              DRM_VIA_PCICMD), &b, sizeof(b))) {
-                ErrorF("DRM command buffer submission failed.\n");
-                viaDumpDMA(cb);
-                return;
-            }
+#ifdef HAVE_PTHREAD
+        if (pVia->submitQueue) {
+            viaSubmitQueue(pVia, cb, request);
+            VIA_PROBE1(flush__done, path);
+            return;
+        }
+#endif
+        if (viaSubmitDRM(pVia->drmmode.fd, request, cb->buf, cb->pos)) {
+            ErrorF("DRM command buffer submission failed.\n");
+            viaDumpDMA(cb);
+            VIA_PROBE1(flush__done, path);
+            return;
         }
         cb->pos = 0;
+        VIA_PROBE1(flush__done, path);
     } else {
+        viaSubmitWait(pVia);
         viaFlushPCI(pVia, cb);
     }
 }
+#else
+void
+viaSubmitWait(VIAPtr pVia)
+{
+}
 #endif
 
 /*
@@ -189,6 +591,7 @@ viaSetupCBuffer(VIAPtr pVia, ViaCommandBuffer *cb, unsigned size)
     cb->header_start = 0;
     cb->rindex = 0;
     cb->has3dState = FALSE;
+    cb->flushReason = VIA_FLUSH_SUBMIT;
     cb->flushFunc = viaFlushPCI;
 #ifdef OPENCHROMEDRI
     if (pVia->directRenderingType == DRI_1) {
@@ -252,17 +655,20 @@ viaSetClippingRectangle(ScrnInfoPtr pScrn, int x1, int y1, int x2, int y2)
 }
 
 /*
- * Check if we need to force upload of the whole 3D state (when other
- * clients or subsystems have touched the 3D engine). Also tell DRI
- * clients and subsystems that we have touched the 3D engine.
+ * Check which 3D state groups we need to upload again because other
+ * clients or subsystems have touched them. DRI clients that track their
+ * changes in the SAREA only cost us the groups they changed, others
+ * the whole state. Also tell DRI clients and subsystems that we have
+ * touched the 3D engine.
  */
-Bool
+CARD32
 viaCheckUpload(ScrnInfoPtr pScrn, Via3DState * v3d)
 {
     VIAPtr pVia = VIAPTR(pScrn);
-    Bool forceUpload;
+    CARD32 forceUpload = 0;
 
-    forceUpload = (pVia->lastToUpload != v3d);
+    if (pVia->lastToUpload != v3d)
+        forceUpload = VIA_3D_STATE_ALL;
     pVia->lastToUpload = v3d;
 
 #ifdef OPENCHROMEDRI
@@ -270,9 +676,17 @@ viaCheckUpload(ScrnInfoPtr pScrn, Via3DState * v3d)
         volatile drm_via_sarea_t *saPriv = (drm_via_sarea_t *)
                 DRIGetSAREAPrivate(pScrn->pScreen);
         int myContext = DRIGetContext(pScrn->pScreen);
-
-        forceUpload = forceUpload || (saPriv->ctxOwner != myContext);
-        saPriv->ctxOwner = myContext;
+        unsigned dirty = saPriv->dirty;
+
+        if (saPriv->ctxOwner != myContext) {
+            if ((dirty & ~VIA_SAREA_3D_ALL) ==
+                VIA_SAREA_3D_TAG(saPriv->ctxOwner))
+                forceUpload |= dirty & VIA_3D_STATE_ALL;
+            else
+                forceUpload = VIA_3D_STATE_ALL;
+            saPriv->ctxOwner = myContext;
+            saPriv->dirty = VIA_SAREA_3D_TAG(myContext);
+        }
     }
 #endif
     return forceUpload;
@@ -288,87 +702,342 @@ viaOrder(CARD32 val, CARD32 * shift)
     return (val == (1 << *shift));
 }
 
+Bool
+viaExpandablePixel(int format)
+{
+    int formatType = PICT_FORMAT_TYPE(format);
+
+    return (formatType == PICT_TYPE_A ||
+            formatType == PICT_TYPE_ABGR || formatType == PICT_TYPE_ARGB);
+}
+
 /*
- * Helper for bitdepth expansion.
+ * Without a mask, clearing, copying a solid source, or blending an opaque
+ * solid source just fills the destination. The 2D engine does that
+ * without any 3D state. Return the fill color in the destination format.
  */
-CARD32
-viaBitExpandHelper(CARD32 pixel, CARD32 bits)
+Bool
+viaExaCompositeFillColor(CARD8 op, PicturePtr pSrcPicture, void *srcP,
+                            PicturePtr pDstPicture, Pixel *fg)
+{
+    CARD32 argb = 0;
+
+    switch (op) {
+    case PictOpClear:
+        break;
+    case PictOpSrc:
+    case PictOpOver:
+        if (!srcP)
+            return FALSE;
+        viaPixelARGB8888(pSrcPicture->format, srcP, &argb);
+        if ((op == PictOpOver) && ((argb >> 24) != 0xFF))
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    switch (pDstPicture->format) {
+    case PICT_a8r8g8b8:
+    case PICT_x8r8g8b8:
+        *fg = argb;
+        break;
+    case PICT_r5g6b5:
+        *fg = ((argb >> 8) & 0xF800) | ((argb >> 5) & 0x07E0) |
+              ((argb >> 3) & 0x001F);
+        break;
+    case PICT_a8:
+        *fg = argb >> 24;
+        break;
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * The 3D engine has no A8 render target. A8 destinations are drawn as
+ * ARGB8888 pictures of a quarter of the width instead, and A8 sources
+ * and masks are sampled as intensity. That gives the right result in
+ * every channel only for operators that never read the destination
+ * alpha, and only for sources and masks without color.
+ */
+Bool
+viaExaCheckCompositeA8(int op, PicturePtr pSrcPicture,
+                        PicturePtr pMaskPicture, PicturePtr pDstPicture)
+{
+    switch (op) {
+    case PictOpClear:
+    case PictOpSrc:
+    case PictOpOver:
+    case PictOpOutReverse:
+    case PictOpAdd:
+        break;
+    default:
+        return FALSE;
+    }
+
+    if ((pDstPicture->pDrawable->width > 4 * VIA_3D_MAX_DIM) ||
+        (pDstPicture->pDrawable->height > VIA_3D_MAX_DIM))
+        return FALSE;
+
+    /* Gradients and solid fills have no drawable to texture from. */
+    if (!pSrcPicture->pDrawable ||
+        (pMaskPicture && !pMaskPicture->pDrawable))
+        return FALSE;
+
+    if (pSrcPicture->transform ||
+        (pMaskPicture && pMaskPicture->transform))
+        return FALSE;
+
+    /* One-pixel sources go as solid color, with the alpha replicated. */
+    if ((pSrcPicture->format != PICT_a8) &&
+        !(pSrcPicture->repeat &&
+          (pSrcPicture->pDrawable->width == 1) &&
+          (pSrcPicture->pDrawable->height == 1) &&
+          viaExpandablePixel(pSrcPicture->format)))
+        return FALSE;
+
+    if (pMaskPicture &&
+        (pMaskPicture->componentAlpha ||
+         ((pMaskPicture->format != PICT_a8) &&
+          !(pMaskPicture->repeat &&
+            (pMaskPicture->pDrawable->width == 1) &&
+            (pMaskPicture->pDrawable->height == 1) &&
+            viaExpandablePixel(pMaskPicture->format)))))
+        return FALSE;
+
+    return TRUE;
+}
+
+/*
+ * Draw onto an A8 destination through its ARGB8888 view, in four passes.
+ * Pass j writes byte j of each 32-bit pixel through the plane mask,
+ * which is A8 pixel 4 * x + j. The textures are stretched by four
+ * horizontally, so that each pass samples the texels of its own pixels.
+ */
+void
+viaExaCompositeA8(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
+                    int dstX, int dstY, int width, int height)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    PictTransform transform;
+    int i, j, x1, x2;
+
+    memset(&transform, 0, sizeof(transform));
+    transform.matrix[0][0] = pixman_int_to_fixed(4);
+    transform.matrix[1][1] = pixman_fixed_1;
+    transform.matrix[2][2] = pixman_fixed_1;
+
+    for (j = 0; j < 4; j++) {
+        /* The 32-bit pixels holding A8 pixels dstX to dstX + width - 1. */
+        x1 = (dstX - j + 3) >> 2;
+        x2 = (dstX + width - j + 3) >> 2;
+        if (x2 <= x1)
+            continue;
+
+        v3d->setDrawing(v3d, 0x0c, 0xFF << (j * 8), v3d->solidColor,
+                        v3d->solidAlpha);
+
+        /* Texel centers of A8 pixel 4 * x + j, from the pixel corners. */
+        for (i = 0; i < v3d->numTextures; i++) {
+            int texX = ((i == 0) ? srcX : maskX) - dstX;
+            int texY = ((i == 0) ? srcY : maskY) - dstY;
+
+            transform.matrix[0][2] = pixman_double_to_fixed(texX + j - 1.5);
+            transform.matrix[1][2] = pixman_int_to_fixed(texY);
+            v3d->setTexTransform(v3d, i, &transform, FALSE);
+        }
+
+        v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+        v3d->emitQuad(pVia, v3d, &pVia->cb, x1, dstY, x1, dstY, x1, dstY,
+                      x2 - x1, height);
+    }
+
+    v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, v3d->solidColor, v3d->solidAlpha);
+}
+
+/*
+ * The 3D engine clips at 2048 pixels. Composite rectangles reaching
+ * beyond that are drawn in 2048 x 2048 tiles, with the destination base
+ * moved to the top left corner of each tile.
+ */
+void
+viaExaCompositeTiled(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
+                        int dstX, int dstY, int width, int height)
 {
-    CARD32 component, mask, tmp;
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    unsigned long dstOffset = exaGetPixmapOffset(pDst);
+    unsigned dstPitch = exaGetPixmapPitch(pDst);
+    int cpp = pDst->drawable.bitsPerPixel >> 3;
+    int x, y, x1, y1, x2, y2;
+
+    for (y = dstY & ~(VIA_3D_MAX_DIM - 1); y < dstY + height;
+         y += VIA_3D_MAX_DIM) {
+        y1 = max(y, dstY);
+        y2 = min(y + VIA_3D_MAX_DIM, dstY + height);
+
+        for (x = dstX & ~(VIA_3D_MAX_DIM - 1); x < dstX + width;
+             x += VIA_3D_MAX_DIM) {
+            x1 = max(x, dstX);
+            x2 = min(x + VIA_3D_MAX_DIM, dstX + width);
+
+            v3d->setDestination(v3d, dstOffset + y * dstPitch + x * cpp,
+                                dstPitch, pVia->dstFormat);
+            v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+            v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0,
+                              min(pDst->drawable.width - x, VIA_3D_MAX_DIM),
+                              min(pDst->drawable.height - y, VIA_3D_MAX_DIM));
+            v3d->emitQuad(pVia, v3d, &pVia->cb, x1 - x, y1 - y,
+                          srcX + x1 - dstX, srcY + y1 - dstY,
+                          maskX + x1 - dstX, maskY + y1 - dstY,
+                          x2 - x1, y2 - y1);
+        }
+    }
 
-    component = pixel & ((1 << bits) - 1);
-    mask = (1 << (8 - bits)) - 1;
-    tmp = component << (8 - bits);
-    return ((component & 1) ? (tmp | mask) : tmp);
+    /* Back to the whole destination for the rest of the batch. */
+    v3d->setDestination(v3d, dstOffset, dstPitch, pVia->dstFormat);
+    v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+    v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0,
+                      min(pDst->drawable.width, VIA_3D_MAX_DIM),
+                      min(pDst->drawable.height, VIA_3D_MAX_DIM));
 }
 
+static const char *viaCompositeRejectNames[VIA_NUM_REJECTS] = {
+    "source drawable",
+    "small source",
+    "small mask",
+    "repeat",
+    "too large",
+    "transform",
+    "component alpha",
+    "operator",
+    "destination format",
+    "mask format",
+    "source format",
+    "prepare"
+};
+
 /*
- * Extract the components from a pixel of the given format to an argb8888 pixel. * This is used to extract data from one-pixel repeat pixmaps.
- * Assumes little endian.
+ * Count a composite operation that is left to software, both by reason
+ * and by operator and picture formats, so that the most common
+ * fallbacks can be found on a running server.
  */
 void
-viaPixelARGB8888(unsigned format, void *pixelP, CARD32 * argb8888)
+viaExaCompositeReject(VIAPtr pVia, int reason, CARD8 op, PicturePtr pSrc,
+                      PicturePtr pMask, PicturePtr pDst)
 {
-    CARD32 bits, shift, pixel, bpp;
+    VIACompositeStatsRec *stats = &pVia->compStats;
+    CARD32 srcFormat = pSrc ? pSrc->format : 0;
+    CARD32 maskFormat = pMask ? pMask->format : 0;
+    CARD32 dstFormat = pDst ? pDst->format : 0;
+    unsigned hash, i;
 
-    bpp = PICT_FORMAT_BPP(format);
+    if (stats->quiet)
+        return;
 
-    if (bpp <= 8) {
-        pixel = *((CARD8 *) pixelP);
-    } else if (bpp <= 16) {
-        pixel = *((CARD16 *) pixelP);
-    } else {
-        pixel = *((CARD32 *) pixelP);
+    stats->rejects[reason]++;
+
+    hash = (srcFormat * 31 + maskFormat) * 31 + dstFormat;
+    hash = (hash * 31 + op) * 31 + reason;
+    for (i = 0; i < VIA_COMPOSITE_STAT_SLOTS; i++) {
+        VIACompositeStatRec *slot =
+            &stats->slots[(hash + i) % VIA_COMPOSITE_STAT_SLOTS];
+
+        if (!slot->count) {
+            slot->srcFormat = srcFormat;
+            slot->maskFormat = maskFormat;
+            slot->dstFormat = dstFormat;
+            slot->op = op;
+            slot->reason = reason;
+        } else if ((slot->srcFormat != srcFormat) ||
+                   (slot->maskFormat != maskFormat) ||
+                   (slot->dstFormat != dstFormat) ||
+                   (slot->op != op) || (slot->reason != reason)) {
+            continue;
+        }
+        slot->count++;
+        break;
     }
+    if (i == VIA_COMPOSITE_STAT_SLOTS)
+        stats->unrecorded++;
 
-    switch (PICT_FORMAT_TYPE(format)) {
-        case PICT_TYPE_A:
-            bits = PICT_FORMAT_A(format);
-            *argb8888 = viaBitExpandHelper(pixel, bits) << 24;
-            return;
-        case PICT_TYPE_ARGB:
-            shift = 0;
-            bits = PICT_FORMAT_B(format);
-            *argb8888 = viaBitExpandHelper(pixel, bits);
-            shift += bits;
-            bits = PICT_FORMAT_G(format);
-            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits) << 8;
-            shift += bits;
-            bits = PICT_FORMAT_R(format);
-            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits) << 16;
-            shift += bits;
-            bits = PICT_FORMAT_A(format);
-            *argb8888 |= ((bits) ? viaBitExpandHelper(pixel >> shift,
-                                                      bits) : 0xFF) << 24;
-            return;
-        case PICT_TYPE_ABGR:
-            shift = 0;
-            bits = PICT_FORMAT_B(format);
-            *argb8888 = viaBitExpandHelper(pixel, bits) << 16;
-            shift += bits;
-            bits = PICT_FORMAT_G(format);
-            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits) << 8;
-            shift += bits;
-            bits = PICT_FORMAT_R(format);
-            *argb8888 |= viaBitExpandHelper(pixel >> shift, bits);
-            shift += bits;
-            bits = PICT_FORMAT_A(format);
-            *argb8888 |= ((bits) ? viaBitExpandHelper(pixel >> shift,
-                                                      bits) : 0xFF) << 24;
-            return;
-        default:
-            break;
+#ifdef VIA_DEBUG_COMPOSITE
+    viaExaPrintCompositeInfo((char *)viaCompositeRejectNames[reason], op,
+                             pSrc, pMask, pDst);
+#endif
+}
+
+static int
+viaExaCompositeStatsPrint(VIACompositeStatsRec *stats, char *buf, int size)
+{
+    int len, i;
+
+    len = snprintf(buf, size,
+                   "accelerated %lu ops %lu pixels, "
+                   "software %lu ops %lu pixels\n",
+                   stats->accelOps, stats->accelPixels,
+                   stats->fallbackOps, stats->fallbackPixels);
+
+    for (i = 0; (i < VIA_NUM_REJECTS) && (len < size); i++) {
+        if (stats->rejects[i])
+            len += snprintf(buf + len, size - len, "%s: %lu\n",
+                            viaCompositeRejectNames[i], stats->rejects[i]);
     }
-    return;
+
+    for (i = 0; (i < VIA_COMPOSITE_STAT_SLOTS) && (len < size); i++) {
+        VIACompositeStatRec *slot = &stats->slots[i];
+
+        if (slot->count)
+            len += snprintf(buf + len, size - len,
+                            "op %u src 0x%08x mask 0x%08x dst 0x%08x %s: "
+                            "%lu\n", slot->op, (unsigned)slot->srcFormat,
+                            (unsigned)slot->maskFormat,
+                            (unsigned)slot->dstFormat,
+                            viaCompositeRejectNames[slot->reason],
+                            slot->count);
+    }
+
+    if (stats->unrecorded && (len < size))
+        len += snprintf(buf + len, size - len, "unrecorded: %lu\n",
+                        stats->unrecorded);
+
+    return min(len, size - 1);
 }
 
-Bool
-viaExpandablePixel(int format)
+/* Interval between updates of the composite statistics, in ms. */
+#define VIA_COMPOSITE_STATS_MS  1000
+
+/*
+ * Publish the composite statistics as the VIA_COMPOSITE_STATS property
+ * of the root window, once a second from a timer and only when they
+ * changed, so that clients watching the root window are not woken up
+ * for nothing. They can be read with "xprop -root VIA_COMPOSITE_STATS".
+ */
+static CARD32
+viaExaCompositeStatsPublish(OsTimerPtr timer, CARD32 now, pointer arg)
 {
-    int formatType = PICT_FORMAT_TYPE(format);
+    ScrnInfoPtr pScrn = arg;
+    VIAPtr pVia = VIAPTR(pScrn);
+    VIACompositeStatsRec *stats = &pVia->compStats;
+    ScreenPtr pScreen = xf86ScrnToScreen(pScrn);
+    unsigned long ops = stats->accelOps + stats->fallbackOps;
+    char buf[4096];
+    int len;
+
+    if (pScreen->root && (ops != stats->publishedOps)) {
+        stats->publishedOps = ops;
+        len = viaExaCompositeStatsPrint(stats, buf, sizeof(buf));
+        dixChangeWindowProperty(serverClient, pScreen->root, stats->atom,
+                                XA_STRING, 8, PropModeReplace, len, buf,
+                                TRUE);
+    }
 
-    return (formatType == PICT_TYPE_A ||
-            formatType == PICT_TYPE_ABGR || formatType == PICT_TYPE_ARGB);
+    return VIA_COMPOSITE_STATS_MS;
 }
 
 #ifdef VIA_DEBUG_COMPOSITE
@@ -465,34 +1134,57 @@ void
 viaAccelSync(ScrnInfoPtr pScrn)
 {
     VIAPtr pVia = VIAPTR(pScrn);
-    int loop = 0;
 
+    VIA_PROBE(sync__start);
+    viaSubmitWait(pVia);
     mem_barrier();
 
-    switch (pVia->Chipset) {
-        case VIA_VX800:
-        case VIA_VX855:
-        case VIA_VX900:
-            while ((VIAGETREG(VIA_REG_STATUS) &
-                    (VIA_CMD_RGTR_BUSY_H5 | VIA_2D_ENG_BUSY_H5 | VIA_3D_ENG_BUSY_H5))
-                   && (loop++ < MAXLOOP)) ;
-            break;
-        case VIA_P4M890:
-        case VIA_K8M890:
-        case VIA_P4M900:
-            while ((VIAGETREG(VIA_REG_STATUS) &
-                    (VIA_CMD_RGTR_BUSY | VIA_2D_ENG_BUSY | VIA_3D_ENG_BUSY))
-                   && (loop++ < MAXLOOP)) ;
-            break;
-        default:
-            while (!(VIAGETREG(VIA_REG_STATUS) & VIA_VR_QUEUE_EMPTY)
-                   && (loop++ < MAXLOOP)) ;
+    viaWaitFor(pVia, VIA_WAIT_IDLE, viaEngineIdle,
+               viaEngineBusyMask(pVia, TRUE));
+    VIA_PROBE(sync__done);
+}
 
-            while ((VIAGETREG(VIA_REG_STATUS) &
-                    (VIA_CMD_RGTR_BUSY | VIA_2D_ENG_BUSY | VIA_3D_ENG_BUSY))
-                   && (loop++ < MAXLOOP)) ;
-            break;
+/*
+ * Copy a rectangle between two frame buffer offsets with the 2D engine,
+ * split into pieces the engine can handle, and wait for it to finish.
+ */
+void
+viaAccelFBCopy(ScrnInfoPtr pScrn, unsigned long srcOffset, unsigned srcPitch,
+               unsigned long dstOffset, unsigned dstPitch,
+               int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    int cpp = (pScrn->bitsPerPixel + 7) >> 3;
+    int x, y, w, h;
+
+    for (y = 0; y < height; y += 4096) {
+        h = ((height - y) > 4096) ? 4096 : (height - y);
+
+        for (x = 0; x < width; x += 4096) {
+            w = ((width - x) > 4096) ? 4096 : (width - x);
+
+            switch (pVia->Chipset) {
+            case VIA_VX800:
+            case VIA_VX855:
+            case VIA_VX900:
+                viaAccelFBCopy_H6(pScrn,
+                                  srcOffset + y * srcPitch + x * cpp,
+                                  srcPitch,
+                                  dstOffset + y * dstPitch + x * cpp,
+                                  dstPitch, w, h);
+                break;
+            default:
+                viaAccelFBCopy_H2(pScrn,
+                                  srcOffset + y * srcPitch + x * cpp,
+                                  srcPitch,
+                                  dstOffset + y * dstPitch + x * cpp,
+                                  dstPitch, w, h);
+                break;
+            }
+        }
     }
+
+    viaAccelSync(pScrn);
 }
 
 /*
@@ -506,8 +1198,10 @@ viaAccelWaitMarker(ScreenPtr pScreen, int marker)
     CARD32 uMarker = marker;
 
     if (pVia->agpDMA) {
-        while ((pVia->lastMarkerRead - uMarker) > (1 << 24))
-            pVia->lastMarkerRead = *(CARD32 *) pVia->markerBuf;
+        VIA_PROBE1(marker__start, uMarker);
+        viaSubmitWait(pVia);
+        viaWaitFor(pVia, VIA_WAIT_MARKER, viaMarkerPassed, uMarker);
+        VIA_PROBE1(marker__done, uMarker);
     } else {
         viaAccelSync(pScrn);
     }
@@ -525,6 +1219,7 @@ viaAccelDMADownload(ScrnInfoPtr pScrn, unsigned long fbOffset,
     Bool doSync[2], useBounceBuffer;
     unsigned pitch, numLines[2];
     int curBuf, err, i, ret, blitHeight;
+    CARD64 start;
 
     ret = 0;
 
@@ -544,10 +1239,12 @@ viaAccelDMADownload(ScrnInfoPtr pScrn, unsigned long fbOffset,
         curBlit = &blit[curBuf];
         if (doSync[curBuf]) {
 
+            start = viaTimeUsec();
             do {
                 err = drmCommandWrite(pVia->drmmode.fd, DRM_VIA_BLIT_SYNC,
                                       &curBlit->sync, sizeof(curBlit->sync));
             } while (err == -EAGAIN);
+            viaWaitAccount(pVia, VIA_WAIT_DMA, start, FALSE);
 
             if (err)
                 return err;
@@ -605,8 +1302,8 @@ viaAccelDMADownload(ScrnInfoPtr pScrn, unsigned long fbOffset,
  * Throughput for large transfers is around 65 MB/s.
  */
 static Bool
-viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
-                         char *dst, int dst_pitch)
+viaExaDownloadRect(PixmapPtr pSrc, int x, int y, int w, int h,
+                   char *dst, int dst_pitch)
 {
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pSrc->drawable.pScreen);
     unsigned wBytes = (pSrc->drawable.bitsPerPixel * w + 7) >> 3;
@@ -626,7 +1323,7 @@ viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
     totSize = wBytes * h;
 
     exaWaitSync(pScrn->pScreen);
-    if (totSize < VIA_MIN_DOWNLOAD) {
+    if (totSize < pVia->minDownload) {
         bounceAligned = (char *) drm_bo_map(pScrn, pVia->drmmode.front_bo) + srcOffset;
 
         while (h--) {
@@ -652,6 +1349,18 @@ viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
     return TRUE;
 }
 
+static Bool
+viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
+                         char *dst, int dst_pitch)
+{
+    Bool ret;
+
+    VIA_PROBE3(download__start, w, h, pSrc->drawable.bitsPerPixel);
+    ret = viaExaDownloadRect(pSrc, x, y, w, h, dst, dst_pitch);
+    VIA_PROBE1(download__done, ret);
+    return ret;
+}
+
 /*
  * Upload to framebuffer memory using memcpy to AGP pipelined with a
  * 3D engine texture operation from AGP to framebuffer. The AGP buffers (2)
@@ -674,7 +1383,7 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
     if (!w || !h)
         return TRUE;
 
-    if (wBytes * h < VIA_MIN_TEX_UPLOAD) {
+    if (wBytes * h < pVia->minTexUpload) {
         dstOffset = x * pDst->drawable.bitsPerPixel;
         if (dstOffset & 3)
             return FALSE;
@@ -695,6 +1404,10 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
     if (!pVia->texAGPBuffer->ptr)
         return FALSE;
 
+    /* The 3D engine cannot reach beyond its clip rectangle. */
+    if ((x + w > VIA_3D_MAX_DIM) || (y + h > VIA_3D_MAX_DIM))
+        return FALSE;
+
     switch (pDst->drawable.bitsPerPixel) {
         case 32:
             format = PICT_a8r8g8b8;
@@ -761,6 +1474,7 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
 
         v3d->emitQuad(pVia, v3d, &pVia->cb, x, y + yOffs,
                         0, (buf) ? height : 0, 0, 0, w, bufH);
+        pVia->cb.flushFunc(pVia, &pVia->cb);
 
         sync[buf] = pVia->exaDriverPtr->MarkSync(pScrn->pScreen);
 
@@ -838,6 +1552,216 @@ viaExaIsOffscreen(PixmapPtr pPix)
     return ret;
 }
 
+#ifdef OPENCHROMEDRI
+/*
+ * A repeating or transformed source has to be copied whole. Not worth
+ * it if that is this many times the area drawn.
+ */
+#define VIA_AGP_COMPOSITE_OVERCOPY  4
+
+/*
+ * Composite from a source that EXA keeps in system memory onto a
+ * destination in VRAM. The part of the source that is drawn is copied
+ * into the AGP scratch area and textured from there, instead of being
+ * composited in software or first migrated into VRAM.
+ */
+static Bool
+viaExaCompositeAGP(CARD8 op, PicturePtr pSrc, PicturePtr pMask,
+                    PicturePtr pDst, INT16 xSrc, INT16 ySrc, INT16 xMask,
+                    INT16 yMask, INT16 xDst, INT16 yDst,
+                    CARD16 width, CARD16 height)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    ExaDriverPtr pExa = pVia->exaDriverPtr;
+    PixmapPtr pSrcPix, pMaskPix = NULL, pDstPix, pScratch;
+    unsigned pitch, wBytes, cpp;
+    int dstXoff = 0, dstYoff = 0, nbox, i;
+    CARD32 order;
+    RegionRec region;
+    BoxRec box;
+    BoxPtr pbox;
+    char *src, *dst;
+
+    if (!pExa || !pExa->PrepareComposite || !pVia->scratchBuffer ||
+        (pVia->scratchBuffer->domain != TTM_PL_TT) || !pVia->scratchAddr)
+        return FALSE;
+
+    if (!pSrc->pDrawable || (pSrc->pDrawable->type != DRAWABLE_PIXMAP) ||
+        pSrc->alphaMap || pDst->alphaMap)
+        return FALSE;
+
+    pSrcPix = (PixmapPtr) pSrc->pDrawable;
+    pDstPix = exaGetDrawablePixmap(pDst->pDrawable);
+    if (!pSrcPix->devPrivate.ptr || viaExaIsOffscreen(pSrcPix) ||
+        !viaExaIsOffscreen(pDstPix))
+        return FALSE;
+
+    if (pMask) {
+        if (!pMask->pDrawable || (pMask->pDrawable->type != DRAWABLE_PIXMAP) ||
+            pMask->alphaMap)
+            return FALSE;
+        pMaskPix = (PixmapPtr) pMask->pDrawable;
+        if (!viaExaIsOffscreen(pMaskPix))
+            return FALSE;
+    }
+
+    /*
+     * EXA has already counted this operation as rejected when it fell
+     * back to software, so the checks here must not count it again.
+     */
+    pVia->compStats.quiet = TRUE;
+    if (!pExa->CheckComposite(op, pSrc, pMask, pDst)) {
+        pVia->compStats.quiet = FALSE;
+        return FALSE;
+    }
+    pVia->compStats.quiet = FALSE;
+
+    cpp = pSrcPix->drawable.bitsPerPixel >> 3;
+    wBytes = pSrcPix->drawable.width * cpp;
+    if (pVia->nPOT[0]) {
+        pitch = ALIGN_TO(wBytes, 32);
+    } else {
+        viaOrder(wBytes, &order);
+        pitch = 1 << order;
+    }
+    if (pitch * pSrcPix->drawable.height > pVia->exaScratchSize * 1024)
+        return FALSE;
+
+    pScratch = GetScratchPixmapHeader(pScreen, pSrcPix->drawable.width,
+                                      pSrcPix->drawable.height,
+                                      pSrcPix->drawable.depth,
+                                      pSrcPix->drawable.bitsPerPixel,
+                                      pitch, pVia->scratchAddr);
+    if (!pScratch)
+        return FALSE;
+
+    xDst += pDst->pDrawable->x;
+    yDst += pDst->pDrawable->y;
+    if (!miComputeCompositeRegion(&region, pSrc, pMask, pDst, xSrc, ySrc,
+                                  xMask, yMask, xDst, yDst, width, height)) {
+        FreeScratchPixmapHeader(pScratch);
+        return TRUE;
+    }
+
+#ifdef COMPOSITE
+    if (pDst->pDrawable->type == DRAWABLE_WINDOW) {
+        dstXoff = -pDstPix->screen_x;
+        dstYoff = -pDstPix->screen_y;
+    }
+#endif
+    REGION_TRANSLATE(pScreen, &region, dstXoff, dstYoff);
+
+    /* Source and mask positions relative to the destination boxes. */
+    xSrc -= xDst + dstXoff;
+    ySrc -= yDst + dstYoff;
+    xMask -= xDst + dstXoff;
+    yMask -= yDst + dstYoff;
+
+    /*
+     * Only the source pixels under the region are copied, at their
+     * place in the scratch pixmap.
+     */
+    box = *REGION_EXTENTS(pScreen, &region);
+    if (pSrc->repeat || pSrc->transform) {
+        if ((CARD64) pSrcPix->drawable.width * pSrcPix->drawable.height >
+            (CARD64) VIA_AGP_COMPOSITE_OVERCOPY * (box.x2 - box.x1) *
+            (box.y2 - box.y1)) {
+            REGION_UNINIT(pScreen, &region);
+            FreeScratchPixmapHeader(pScratch);
+            return FALSE;
+        }
+        box.x1 = box.y1 = 0;
+        box.x2 = pSrcPix->drawable.width;
+        box.y2 = pSrcPix->drawable.height;
+    } else {
+        box.x1 = max(box.x1 + xSrc, 0);
+        box.y1 = max(box.y1 + ySrc, 0);
+        box.x2 = min(box.x2 + xSrc, pSrcPix->drawable.width);
+        box.y2 = min(box.y2 + ySrc, pSrcPix->drawable.height);
+    }
+
+    /* The last composite from the scratch area may still be running. */
+    pExa->WaitMarker(pScreen, pVia->scratchMarker);
+
+    src = (char *)pSrcPix->devPrivate.ptr + box.y1 * pSrcPix->devKind +
+          box.x1 * cpp;
+    dst = pVia->scratchAddr + box.y1 * pitch + box.x1 * cpp;
+    for (i = box.y1; (i < box.y2) && (box.x2 > box.x1); i++) {
+        memcpy(dst, src, (box.x2 - box.x1) * cpp);
+        dst += pitch;
+        src += pSrcPix->devKind;
+    }
+
+    pVia->compStats.quiet = TRUE;
+    if (!pExa->PrepareComposite(op, pSrc, pMask, pDst, pScratch, pMaskPix,
+                                pDstPix)) {
+        pVia->compStats.quiet = FALSE;
+        REGION_UNINIT(pScreen, &region);
+        FreeScratchPixmapHeader(pScratch);
+        return FALSE;
+    }
+    pVia->compStats.quiet = FALSE;
+
+    nbox = REGION_NUM_RECTS(&region);
+    pbox = REGION_RECTS(&region);
+    while (nbox--) {
+        pExa->Composite(pDstPix, pbox->x1 + xSrc, pbox->y1 + ySrc,
+                        pbox->x1 + xMask, pbox->y1 + yMask, pbox->x1,
+                        pbox->y1, pbox->x2 - pbox->x1, pbox->y2 - pbox->y1);
+        pbox++;
+    }
+    pExa->DoneComposite(pDstPix);
+
+    /*
+     * This is reached from inside an EXA software fallback, so EXA does
+     * not know the engine drew. Marking a sync makes it wait before the
+     * CPU touches the destination again.
+     */
+    exaMarkSync(pScreen);
+    pVia->scratchMarker = pExa->lastMarker;
+
+    REGION_UNINIT(pScreen, &region);
+    FreeScratchPixmapHeader(pScratch);
+    return TRUE;
+}
+
+#endif /* OPENCHROMEDRI */
+
+/*
+ * Wrapped below EXA, so that it is reached through EXA's software
+ * fallback, after EXA has prepared the pixmaps for access.
+ */
+static void
+viaExaComposite(CARD8 op, PicturePtr pSrc, PicturePtr pMask,
+                PicturePtr pDst, INT16 xSrc, INT16 ySrc, INT16 xMask,
+                INT16 yMask, INT16 xDst, INT16 yDst,
+                CARD16 width, CARD16 height)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+
+#ifdef OPENCHROMEDRI
+    if ((pVia->directRenderingType == DRI_1) && !pVia->IsPCI &&
+        !pVia->noComposite &&
+        viaExaCompositeAGP(op, pSrc, pMask, pDst, xSrc, ySrc, xMask, yMask,
+                           xDst, yDst, width, height))
+        return;
+#endif
+
+    pVia->compStats.fallbackOps++;
+    pVia->compStats.fallbackPixels += width * height;
+
+    ps->Composite = pVia->savedComposite;
+    ps->Composite(op, pSrc, pMask, pDst, xSrc, ySrc, xMask, yMask,
+                  xDst, yDst, width, height);
+    pVia->savedComposite = ps->Composite;
+    ps->Composite = viaExaComposite;
+}
+
 Bool
 viaInitExa(ScreenPtr pScreen)
 {
@@ -864,6 +1788,9 @@ viaInitExa(ScreenPtr pScreen)
         return FALSE;
     }
 
+    if (pVia->cmdTraceFile)
+        viaOpenCommandTrace(pScrn);
+
     pExa = exaDriverAlloc();
     if (!pExa) {
         return FALSE;
@@ -895,9 +1822,14 @@ viaInitExa(ScreenPtr pScreen)
      *     Pitch: ((1 << 10) - 1)*32 = 32736
      *     Clip Rectangle: Color Window, 12bits. As Spec saied: 0 - 2048
      *                     Scissor is the same as color window.
+     *
+     *  Pixmaps follow the 2D limits. The widest one is 4092 pixels, so
+     *  that a 16-byte aligned 32 bpp pitch still fits the 2D pitch field.
+     *  Composites into larger pixmaps are split into 3D-sized tiles, and
+     *  larger pictures are not used as textures.
      */
-    pExa->maxX = 2047;
-    pExa->maxY = 2047;
+    pExa->maxX = 4092;
+    pExa->maxY = 4095;
     pExa->WaitMarker = viaAccelWaitMarker;
 
     switch (pVia->Chipset) {
@@ -948,13 +1880,13 @@ viaInitExa(ScreenPtr pScreen)
             pExa->CheckComposite = viaExaCheckComposite_H6;
             pExa->PrepareComposite = viaExaPrepareComposite_H6;
             pExa->Composite = viaExaComposite_H6;
-            pExa->DoneComposite = viaExaDoneSolidCopy_H6;
+            pExa->DoneComposite = viaExaDoneComposite_H6;
             break;
         default:
             pExa->CheckComposite = viaExaCheckComposite_H2;
             pExa->PrepareComposite = viaExaPrepareComposite_H2;
             pExa->Composite = viaExaComposite_H2;
-            pExa->DoneComposite = viaExaDoneSolidCopy_H2;
+            pExa->DoneComposite = viaExaDoneComposite_H2;
             break;
         }
     } else {
@@ -962,6 +1894,14 @@ viaInitExa(ScreenPtr pScreen)
                    "[EXA] Disabling EXA accelerated composite.\n");
     }
 
+    /* Must be wrapped before EXA, to be called from its fallbacks. */
+    if (GetPictureScreenIfSet(pScreen)) {
+        PictureScreenPtr ps = GetPictureScreen(pScreen);
+
+        pVia->savedComposite = ps->Composite;
+        ps->Composite = viaExaComposite;
+    }
+
     if (!exaDriverInit(pScreen, pExa)) {
         free(pExa);
         return FALSE;
@@ -974,6 +1914,367 @@ viaInitExa(ScreenPtr pScreen)
     return TRUE;
 }
 
+/*
+ * Offload threshold calibration.
+ *
+ * The CPU and GPU paths of composite, texture upload and download are
+ * timed at increasing sizes.  The first size at which the GPU wins
+ * becomes the threshold below which the operation stays on the CPU.
+ * If the GPU never wins, the built-in threshold is kept.
+ * Results can be kept in a cache file, one line per chipset, so that
+ * later starts skip the measurements.
+ */
+#define VIA_CALIB_REPS      8
+#define VIA_CALIB_MIN_DIM   8
+#define VIA_CALIB_MAX_DIM   256
+
+static CARD64
+viaCalibMemcpy(void *dst, const void *src, unsigned size)
+{
+    CARD64 start = viaTimeUsec();
+    int i;
+
+    for (i = 0; i < VIA_CALIB_REPS; i++)
+        memcpy(dst, src, size);
+
+    return viaTimeUsec() - start;
+}
+
+static CARD64
+viaCalibCPUComposite(CARD8 *src, CARD8 *dst, int w, int h)
+{
+    pixman_image_t *srcImage, *dstImage;
+    CARD64 start;
+    int i;
+
+    srcImage = pixman_image_create_bits(PIXMAN_a8r8g8b8, w, h,
+                                        (uint32_t *) src, w * 4);
+    dstImage = pixman_image_create_bits(PIXMAN_a8r8g8b8, w, h,
+                                        (uint32_t *) dst, w * 4);
+
+    start = viaTimeUsec();
+    if (srcImage && dstImage) {
+        for (i = 0; i < VIA_CALIB_REPS; i++)
+            pixman_image_composite(PIXMAN_OP_OVER, srcImage, NULL,
+                                   dstImage, 0, 0, 0, 0, 0, 0, w, h);
+    }
+    start = viaTimeUsec() - start;
+
+    if (srcImage)
+        pixman_image_unref(srcImage);
+    if (dstImage)
+        pixman_image_unref(dstImage);
+    return start;
+}
+
+/*
+ * Small pictures start out in system memory. To composite one on the
+ * GPU, EXA first copies it into VRAM, waiting for the engine before it
+ * touches VRAM, and the 3D engine then blends it onto the destination.
+ */
+static CARD64
+viaCalibGPUComposite(ScrnInfoPtr pScrn, CARD8 *srcMap, CARD8 *sys,
+                     unsigned long srcOffset, unsigned long dstOffset,
+                     int w, int h)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    CARD32 wOrder, hOrder;
+    CARD64 start;
+    int i;
+
+    viaOrder(w, &wOrder);
+    viaOrder(h, &hOrder);
+
+    start = viaTimeUsec();
+    for (i = 0; i < VIA_CALIB_REPS; i++) {
+        viaAccelSync(pScrn);
+        memcpy(srcMap, sys, w * h * 4);
+
+        v3d->setDestination(v3d, dstOffset, w * 4, PICT_a8r8g8b8);
+        v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x000000FF, 0x00);
+        v3d->setFlags(v3d, 1, TRUE, TRUE, TRUE);
+        v3d->setCompositeOperator(v3d, PictOpOver);
+        v3d->setTexture(v3d, 0, srcOffset, w * 4, FALSE, 1 << wOrder,
+                        1 << hOrder, PICT_a8r8g8b8, via_repeat, via_repeat,
+                        via_src, FALSE);
+        v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+        v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0, w, h);
+        v3d->emitQuad(pVia, v3d, &pVia->cb, 0, 0, 0, 0, 0, 0, w, h);
+        pVia->cb.flushFunc(pVia, &pVia->cb);
+    }
+    viaAccelSync(pScrn);
+
+    return viaTimeUsec() - start;
+}
+
+static CARD64
+viaCalibGPUBlit(ScrnInfoPtr pScrn, unsigned long srcOffset,
+                unsigned long dstOffset, int w, int h)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 start;
+    int i;
+
+    viaAccelSync(pScrn);
+    start = viaTimeUsec();
+    for (i = 0; i < VIA_CALIB_REPS; i++)
+        viaAccelTextureBlit(pScrn, srcOffset, w * 4, w, h, 0, 0,
+                            PICT_a8r8g8b8, dstOffset, w * 4, 0, 0,
+                            PICT_a8r8g8b8, 0);
+    viaAccelSync(pScrn);
+
+    return viaTimeUsec() - start;
+}
+
+/*
+ * Open the calibration cache for reading, without following a symbolic
+ * link to some other file.
+ */
+static FILE *
+viaExaOpenCalibration(VIAPtr pVia)
+{
+    FILE *file;
+    int fd;
+
+    fd = open(pVia->exaCalibrationCache, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0)
+        return NULL;
+    file = fdopen(fd, "r");
+    if (!file)
+        close(fd);
+    return file;
+}
+
+static Bool
+viaExaLoadCalibration(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    unsigned composite, texUpload, download;
+    int chipset, chipRev;
+    char line[128];
+    Bool found = FALSE;
+    FILE *file;
+
+    if (!pVia->exaCalibrationCache)
+        return FALSE;
+
+    file = viaExaOpenCalibration(pVia);
+    if (!file)
+        return FALSE;
+
+    while (!found && fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%d %d %u %u %u", &chipset, &chipRev,
+                   &composite, &texUpload, &download) != 5)
+            continue;
+        if ((chipset != pVia->Chipset) || (chipRev != pVia->ChipRev))
+            continue;
+
+        pVia->minComposite = composite;
+        pVia->minTexUpload = texUpload;
+        pVia->minDownload = download;
+        found = TRUE;
+    }
+    fclose(file);
+
+    if (found)
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "Read offload thresholds from %s.\n",
+                   pVia->exaCalibrationCache);
+    return found;
+}
+
+static void
+viaExaSaveCalibration(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    char line[128], *lines = NULL;
+    size_t len = 0, lineLen;
+    unsigned composite, texUpload, download;
+    int chipset, chipRev, fd;
+    char *tmpName;
+    FILE *file;
+    Bool ok;
+
+    if (!pVia->exaCalibrationCache)
+        return;
+
+    /* Keep the entries of other chipsets. */
+    file = viaExaOpenCalibration(pVia);
+    if (file) {
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "%d %d %u %u %u", &chipset, &chipRev,
+                       &composite, &texUpload, &download) != 5)
+                continue;
+            if ((chipset == pVia->Chipset) && (chipRev == pVia->ChipRev))
+                continue;
+
+            lineLen = strlen(line);
+            lines = realloc(lines, len + lineLen + 1);
+            if (!lines)
+                break;
+            memcpy(lines + len, line, lineLen + 1);
+            len += lineLen;
+        }
+        fclose(file);
+    }
+
+    /*
+     * The server runs as root, so never write through the configured
+     * path. Write a new file next to it, which mkstemp() creates with
+     * O_EXCL, and rename it over the cache once it is complete, so that
+     * the cache is never seen half written.
+     */
+    tmpName = malloc(strlen(pVia->exaCalibrationCache) + 8);
+    if (!tmpName) {
+        free(lines);
+        return;
+    }
+    sprintf(tmpName, "%s.XXXXXX", pVia->exaCalibrationCache);
+
+    file = NULL;
+    fd = mkstemp(tmpName);
+    if (fd >= 0) {
+        fchmod(fd, 0644);
+        file = fdopen(fd, "w");
+        if (!file)
+            close(fd);
+    }
+    if (!file) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Could not write offload thresholds to %s: %s.\n",
+                   pVia->exaCalibrationCache, strerror(errno));
+        if (fd >= 0)
+            unlink(tmpName);
+        free(tmpName);
+        free(lines);
+        return;
+    }
+
+    fprintf(file, "# chipset revision composite texupload download\n");
+    if (lines)
+        fputs(lines, file);
+    fprintf(file, "%d %d %u %u %u\n", pVia->Chipset, pVia->ChipRev,
+            pVia->minComposite, pVia->minTexUpload, pVia->minDownload);
+    ok = (fflush(file) == 0) && !ferror(file) && (fsync(fileno(file)) == 0);
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(tmpName, pVia->exaCalibrationCache)) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Could not write offload thresholds to %s: %s.\n",
+                   pVia->exaCalibrationCache, strerror(errno));
+        unlink(tmpName);
+    }
+    free(tmpName);
+    free(lines);
+}
+
+static void
+viaExaCalibrate(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    unsigned long size = VIA_CALIB_MAX_DIM * VIA_CALIB_MAX_DIM * 4;
+    struct buffer_object *vram;
+    CARD64 start, cpu, gpu;
+    CARD8 *fb, *sys;
+    unsigned bytes;
+    int dim;
+
+    if (!pVia->exaCalibrate || viaExaLoadCalibration(pScrn))
+        return;
+
+    vram = drm_bo_alloc(pScrn, size * 2, 32, TTM_PL_VRAM);
+    if (!vram)
+        return;
+    fb = drm_bo_map(pScrn, vram);
+    sys = malloc(size * 2);
+    if (!fb || !sys) {
+        free(sys);
+        drm_bo_free(pScrn, vram);
+        return;
+    }
+
+    start = viaTimeUsec();
+
+    /* Translucent pixels, so that no fast path skips the blending. */
+    memset(fb, 0x80, size * 2);
+    memset(sys, 0x80, size * 2);
+
+    /*
+     * Composite, in source pixels. Software composites run on pictures
+     * in system memory.
+     */
+    if (!pVia->noComposite) {
+        pVia->minComposite = VIA_MIN_COMPOSITE;
+        for (dim = VIA_CALIB_MIN_DIM; dim <= VIA_CALIB_MAX_DIM; dim <<= 1) {
+            cpu = viaCalibCPUComposite(sys, sys + size, dim, dim);
+            gpu = viaCalibGPUComposite(pScrn, fb, sys, vram->offset,
+                                       vram->offset + size, dim, dim);
+            if (gpu < cpu) {
+                pVia->minComposite = dim * dim;
+                break;
+            }
+        }
+    }
+
+    /*
+     * Texture upload, in bytes.  The GPU path copies into AGP memory
+     * and blits from there with the 3D engine.
+     */
+    if (pVia->texAGPBuffer) {
+        pVia->minTexUpload = VIA_MIN_TEX_UPLOAD;
+        for (dim = VIA_CALIB_MIN_DIM; dim <= VIA_CALIB_MAX_DIM; dim <<= 1) {
+            bytes = dim * dim * 4;
+            cpu = viaCalibMemcpy(fb, sys, bytes);
+            gpu = viaCalibMemcpy(sys + size, sys, bytes) +
+                  viaCalibGPUBlit(pScrn, vram->offset, vram->offset + size,
+                                  dim, dim);
+            if (gpu < cpu) {
+                pVia->minTexUpload = bytes;
+                break;
+            }
+        }
+    }
+
+#ifdef OPENCHROMEDRI
+    /* Download, in bytes, through PCI DMA. */
+    if (pVia->directRenderingType && pVia->dBounce) {
+        pVia->minDownload = VIA_MIN_DOWNLOAD;
+        for (dim = VIA_CALIB_MIN_DIM; dim <= VIA_CALIB_MAX_DIM; dim <<= 1) {
+            int i;
+
+            bytes = dim * dim * 4;
+            cpu = viaCalibMemcpy(sys, fb, bytes);
+
+            gpu = viaTimeUsec();
+            for (i = 0; i < VIA_CALIB_REPS; i++) {
+                if (viaAccelDMADownload(pScrn, vram->offset, dim * 4, sys,
+                                        dim * 4, dim * 4, dim))
+                    break;
+            }
+            gpu = (i < VIA_CALIB_REPS) ? cpu : viaTimeUsec() - gpu;
+
+            if (gpu < cpu) {
+                pVia->minDownload = bytes;
+                break;
+            }
+        }
+    }
+#endif /* OPENCHROMEDRI */
+
+    free(sys);
+    drm_bo_free(pScrn, vram);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_PROBED,
+               "Offload thresholds: composite %u pixels, texture upload "
+               "%u bytes, download %u bytes (calibrated in %u ms).\n",
+               pVia->minComposite, pVia->minTexUpload, pVia->minDownload,
+               (unsigned) ((viaTimeUsec() - start) / 1000));
+
+    viaExaSaveCalibration(pScrn);
+}
+
 /*
  * Allocate a command buffer and  buffers for accelerated upload, download,
  * and EXA scratch area. The scratch area resides primarily in AGP memory,
@@ -1033,6 +2334,24 @@ viaFinishInitAccel(ScreenPtr pScreen)
         }
     }
     memset(pVia->markerBuf, 0, pVia->exa_sync_bo->size);
+
+#if defined(OPENCHROMEDRI) && defined(HAVE_PTHREAD)
+    if (pVia->asyncSubmit && pVia->directRenderingType == DRI_1 &&
+        pVia->cb.flushFunc == viaFlushDRIEnabled)
+        viaStartSubmitThread(pScreen);
+#endif
+
+    if (pVia->useEXA) {
+        viaExaCalibrate(pScreen);
+
+        /* Atoms do not survive a server regeneration. */
+        pVia->compStats.atom = MakeAtom("VIA_COMPOSITE_STATS",
+                                        sizeof("VIA_COMPOSITE_STATS") - 1,
+                                        TRUE);
+        pVia->compStats.publishedOps = 0;
+        pVia->compStats.timer = TimerSet(NULL, 0, VIA_COMPOSITE_STATS_MS,
+                                         viaExaCompositeStatsPublish, pScrn);
+    }
 }
 
 /*
@@ -1043,11 +2362,61 @@ viaExitAccel(ScreenPtr pScreen)
 {
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
     VIAPtr pVia = VIAPTR(pScrn);
+    int i;
 
     viaAccelSync(pScrn);
+#if defined(OPENCHROMEDRI) && defined(HAVE_PTHREAD)
+    viaStopSubmitThread(pScreen);
+#endif
     viaTearDownCBuffer(&pVia->cb);
 
+    if (pVia->cmdTrace) {
+        fclose(pVia->cmdTrace);
+        pVia->cmdTrace = NULL;
+    }
+
+    if (pVia->mmioFlushes) {
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "MMIO command submission: %lu flushes, "
+                   "%lu us average stall per flush.\n", pVia->mmioFlushes,
+                   (unsigned long)(pVia->waitStats[VIA_WAIT_QUEUE].usec /
+                                   pVia->mmioFlushes));
+    }
+
+    for (i = 0; i < VIA_NUM_WAITS; i++) {
+        VIAWaitStatRec *stat = &pVia->waitStats[i];
+
+        if (!stat->waits)
+            continue;
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "Waited for %s %lu times, %lu ms in total, "
+                   "%lu us at most, %lu timeouts.\n", viaWaitNames[i],
+                   stat->waits, (unsigned long)(stat->usec / 1000),
+                   (unsigned long)stat->maxUsec, stat->timeouts);
+    }
+
     if (pVia->useEXA) {
+        VIACompositeStatsRec *stats = &pVia->compStats;
+
+        if (stats->timer) {
+            TimerFree(stats->timer);
+            stats->timer = NULL;
+        }
+
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "[EXA] Composite: %lu operations (%lu pixels) accelerated, "
+                   "%lu operations (%lu pixels) in software.\n",
+                   stats->accelOps, stats->accelPixels,
+                   stats->fallbackOps, stats->fallbackPixels);
+
+        if (pVia->savedComposite) {
+            PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+
+            if (ps && (ps->Composite == viaExaComposite))
+                ps->Composite = pVia->savedComposite;
+            pVia->savedComposite = NULL;
+        }
+
 #ifdef OPENCHROMEDRI
         if (pVia->directRenderingType == DRI_1) {
             if (pVia->texAGPBuffer) {
@@ -160,14 +160,13 @@ viaExaPrepareSolid_H2(PixmapPtr pPixmap, int alu, Pixel planeMask, Pixel fg)
     return TRUE;
 }
 
-void
-viaExaSolid_H2(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+/*
+ * Emit a solid fill without flushing, so that fills can be batched.
+ */
+static void
+viaAccelSolidHelper_H2(VIAPtr pVia, CARD32 dstOffset, CARD32 dstPitch,
+                        int x1, int y1, int w, int h)
 {
-    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
-    CARD32 dstOffset = exaGetPixmapOffset(pPixmap);
-    CARD32 dstPitch = exaGetPixmapPitch(pPixmap);
-    int w = x2 - x1, h = y2 - y1;
-    VIAPtr pVia = VIAPTR(pScrn);
     ViaTwodContext *tdc = &pVia->td;
 
     RING_VARS;
@@ -180,13 +179,32 @@ viaExaSolid_H2(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
     OUT_RING_H1(VIA_REG_DIMENSION, ((h - 1) << 16) | (w - 1));
     OUT_RING_H1(VIA_REG_FGCOLOR, tdc->fgColor);
     OUT_RING_H1(VIA_REG_GECMD, tdc->cmd);
+}
 
-    ADVANCE_RING;
+void
+viaExaSolid_H2(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    viaAccelSolidHelper_H2(pVia, exaGetPixmapOffset(pPixmap),
+                            exaGetPixmapPitch(pPixmap), x1, y1,
+                            x2 - x1, y2 - y1);
 }
 
+/*
+ * The fills or copies of one batch go out together, in one submission
+ * instead of one per rectangle, unless the command buffer fills up.
+ */
 void
 viaExaDoneSolidCopy_H2(PixmapPtr pPixmap)
 {
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    RING_VARS;
+
+    ADVANCE_RING;
 }
 
 Bool
@@ -259,6 +277,43 @@ viaExaCopy_H2(PixmapPtr pDstPixmap, int srcX, int srcY, int dstX, int dstY,
     OUT_RING_H1(VIA_REG_DSTPOS, (dstY << 16) | (dstX & 0xFFFF));
     OUT_RING_H1(VIA_REG_DIMENSION, ((height - 1) << 16) | (width - 1));
     OUT_RING_H1(VIA_REG_GECMD, tdc->cmd);
+}
+
+/*
+ * Copy a rectangle between two frame buffer offsets, without pixmaps.
+ * The rectangle must not exceed the 2D engine's 4096 x 4096 limit.
+ */
+void
+viaAccelFBCopy_H2(ScrnInfoPtr pScrn, unsigned long srcOffset,
+                    unsigned srcPitch, unsigned long dstOffset,
+                    unsigned dstPitch, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaTwodContext *tdc = &pVia->td;
+    CARD32 val;
+
+    RING_VARS;
+
+    if (!width || !height)
+        return;
+
+    tdc->cmd = VIA_GEC_BLT | VIAACCELCOPYROP(GXcopy);
+    if (!viaAccelSetMode(pScrn->bitsPerPixel, tdc))
+        return;
+    viaAccelPlaneMaskHelper_H2(tdc, 0xFFFFFFFF);
+    viaAccelTransparentHelper_H2(pVia, 0x0, 0x0, TRUE);
+
+    val = VIA_PITCH_ENABLE | (dstPitch >> 3) << 16 | (srcPitch >> 3);
+
+    BEGIN_RING(16);
+    OUT_RING_H1(VIA_REG_GEMODE, tdc->mode);
+    OUT_RING_H1(VIA_REG_SRCBASE, srcOffset >> 3);
+    OUT_RING_H1(VIA_REG_DSTBASE, dstOffset >> 3);
+    OUT_RING_H1(VIA_REG_PITCH, val);
+    OUT_RING_H1(VIA_REG_SRCPOS, 0);
+    OUT_RING_H1(VIA_REG_DSTPOS, 0);
+    OUT_RING_H1(VIA_REG_DIMENSION, ((height - 1) << 16) | (width - 1));
+    OUT_RING_H1(VIA_REG_GECMD, tdc->cmd);
 
     ADVANCE_RING;
 }
@@ -271,71 +326,104 @@ viaExaCheckComposite_H2(int op, PicturePtr pSrcPicture,
     VIAPtr pVia = VIAPTR(pScrn);
     Via3DState *v3d = &pVia->v3d;
 
-    if (!pSrcPicture->pDrawable)
+    if (!pSrcPicture->pDrawable) {
+        viaExaCompositeReject(pVia, VIA_REJECT_SRC_DRAWABLE, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
+    }
 
     /* Reject small composites early. They are done much faster in software. */
     if (!pSrcPicture->repeat &&
         pSrcPicture->pDrawable->width *
-        pSrcPicture->pDrawable->height < VIA_MIN_COMPOSITE)
+        pSrcPicture->pDrawable->height < pVia->minComposite) {
+        viaExaCompositeReject(pVia, VIA_REJECT_SRC_SMALL, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
+    }
 
     if (pMaskPicture && pMaskPicture->pDrawable &&
         !pMaskPicture->repeat &&
         pMaskPicture->pDrawable->width *
-        pMaskPicture->pDrawable->height < VIA_MIN_COMPOSITE)
+        pMaskPicture->pDrawable->height < pVia->minComposite) {
+        viaExaCompositeReject(pVia, VIA_REJECT_MASK_SMALL, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
+    }
 
     if (pMaskPicture && pMaskPicture->repeat &&
-        pMaskPicture->repeatType != RepeatNormal)
+        pMaskPicture->repeatType != RepeatNormal) {
+        viaExaCompositeReject(pVia, VIA_REJECT_REPEAT, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
+    }
 
-    if (pMaskPicture && pMaskPicture->componentAlpha) {
-#ifdef VIA_DEBUG_COMPOSITE
-        viaExaPrintCompositeInfo("Component Alpha operation", op,  pSrcPicture, pMaskPicture, pDstPicture);
-#endif
+    /* Larger pictures do not fit in a texture. */
+    if ((pSrcPicture->pDrawable->width > VIA_3D_MAX_DIM) ||
+        (pSrcPicture->pDrawable->height > VIA_3D_MAX_DIM) ||
+        (pMaskPicture && pMaskPicture->pDrawable &&
+         ((pMaskPicture->pDrawable->width > VIA_3D_MAX_DIM) ||
+          (pMaskPicture->pDrawable->height > VIA_3D_MAX_DIM)))) {
+        viaExaCompositeReject(pVia, VIA_REJECT_TOO_LARGE, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
+        return FALSE;
+    }
+
+    if (!v3d->transformSupported(pSrcPicture) ||
+        (pMaskPicture && !v3d->transformSupported(pMaskPicture))) {
+        viaExaCompositeReject(pVia, VIA_REJECT_TRANSFORM, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
+        return FALSE;
+    }
+
+    /*
+     * A component-alpha mask can only be combined with either the source
+     * alpha or the source color.  EXA splits PictOpOver into such an
+     * OutReverse and an Add pass, run over the whole glyph run each.
+     */
+    if (pMaskPicture && pMaskPicture->componentAlpha &&
+        (op != PictOpOutReverse) && (op != PictOpAdd)) {
+        viaExaCompositeReject(pVia, VIA_REJECT_COMPONENT_ALPHA, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
     }
 
     if (!v3d->opSupported(op)) {
-#ifdef VIA_DEBUG_COMPOSITE
-        viaExaPrintCompositeInfo("Operator not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
+        viaExaCompositeReject(pVia, VIA_REJECT_OPERATOR, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
     }
 
     /*
-     * FIXME: A8 destination formats are currently not supported and do not
-     * seem supported by the hardware, although there are some leftover
-     * register settings apparent in the via_3d_reg.h file. We need to fix this
-     * (if important), by using component ARGB8888 operations with bitmask.
+     * A8 destination formats are not supported by the hardware, although
+     * there are some leftover register settings apparent in the
+     * via_3d_reg.h file. They are drawn through an ARGB8888 view instead,
+     * which limits the sources, masks and operators.
      */
 
-    if (!v3d->dstSupported(pDstPicture->format)) {
-#ifdef VIA_DEBUG_COMPOSITE
-        viaExaPrintCompositeInfo(" Destination format not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
+    if ((pDstPicture->format == PICT_a8)
+        ? !viaExaCheckCompositeA8(op, pSrcPicture, pMaskPicture, pDstPicture)
+        : !v3d->dstSupported(pDstPicture->format)) {
+        viaExaCompositeReject(pVia, VIA_REJECT_DST_FORMAT, op,
+                              pSrcPicture, pMaskPicture, pDstPicture);
         return FALSE;
     }
 
     if (v3d->texSupported(pSrcPicture->format)) {
         if (pMaskPicture && (PICT_FORMAT_A(pMaskPicture->format) == 0 ||
                              !v3d->texSupported(pMaskPicture->format))) {
-#ifdef VIA_DEBUG_COMPOSITE
-            viaExaPrintCompositeInfo("Mask format not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
+            viaExaCompositeReject(pVia, VIA_REJECT_MASK_FORMAT, op,
+                                  pSrcPicture, pMaskPicture, pDstPicture);
             return FALSE;
         }
         return TRUE;
     }
-#ifdef VIA_DEBUG_COMPOSITE
-    viaExaPrintCompositeInfo("Src format not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
+    viaExaCompositeReject(pVia, VIA_REJECT_SRC_FORMAT, op,
+                          pSrcPicture, pMaskPicture, pDstPicture);
     return FALSE;
 }
 
-Bool
-viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
+static Bool
+viaExaDoPrepareComposite_H2(int op, PicturePtr pSrcPicture,
                             PicturePtr pMaskPicture, PicturePtr pDstPicture,
                             PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst)
 {
@@ -346,7 +434,11 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
     int curTex = 0;
     ViaTexBlendingModes srcMode;
     Bool isAGP;
+    Bool compOutReverse = (pMaskPicture && pMaskPicture->componentAlpha &&
+                           (op == PictOpOutReverse));
     unsigned long offset;
+    Pixel fg;
+    Bool a8 = (pDstPicture->format == PICT_a8);
 
     /* Workaround: EXA crash with new libcairo2 on a VIA VX800 (#298) */
     /* TODO Add real source only pictures */
@@ -355,9 +447,13 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
 	    return FALSE;
 	}
 
+    pVia->compositeFill = FALSE;
+    pVia->dstFormat = pDstPicture->format;
     v3d->setDestination(v3d, exaGetPixmapOffset(pDst),
-                        exaGetPixmapPitch(pDst), pDstPicture->format);
-    v3d->setCompositeOperator(v3d, op);
+                        exaGetPixmapPitch(pDst),
+                        (a8) ? PICT_a8r8g8b8 : pDstPicture->format);
+    v3d->setCompositeOperator(v3d, (compOutReverse)
+                                    ? VIA_OP_COMP_OUT_REVERSE : op);
     v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x000000FF, 0xFF);
 
     viaOrder(pSrc->drawable.width, &width);
@@ -372,7 +468,7 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
 
     srcMode = via_src;
     pVia->maskP = NULL;
-    if (pMaskPicture &&
+    if (pMaskPicture && !compOutReverse &&
         (pMaskPicture->pDrawable->height == 1) &&
         (pMaskPicture->pDrawable->width == 1) &&
         pMaskPicture->repeat && viaExpandablePixel(pMaskPicture->format)) {
@@ -404,6 +500,14 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
         return FALSE;
     }
 
+    if (!pMaskPicture &&
+        viaExaCompositeFillColor(op, pSrcPicture, pVia->srcP, pDstPicture,
+                                 &fg) &&
+        viaExaPrepareSolid_H2(pDst, GXcopy, 0xFFFFFFFF, fg)) {
+        pVia->compositeFill = TRUE;
+        return TRUE;
+    }
+
     if (!pVia->srcP) {
         offset = exaGetPixmapOffset(pSrc);
         isAGP = viaIsAGP(pVia, pSrc, &offset);
@@ -411,10 +515,13 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
             return FALSE;
         if (!v3d->setTexture(v3d, curTex, offset,
                              exaGetPixmapPitch(pSrc), pVia->nPOT[curTex],
-                             1 << width, 1 << height, pSrcPicture->format,
+                             1 << width, 1 << height,
+                             (a8) ? VIA_FMT_A8_INTENSITY : pSrcPicture->format,
                              via_repeat, via_repeat, srcMode, isAGP)) {
             return FALSE;
         }
+        v3d->setTexTransform(v3d, curTex, pSrcPicture->transform,
+                             pSrcPicture->filter == PictFilterBilinear);
         curTex++;
     }
 
@@ -427,20 +534,44 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
         viaOrder(pMask->drawable.height, &height);
         if (!v3d->setTexture(v3d, curTex, offset,
                              exaGetPixmapPitch(pMask), pVia->nPOT[curTex],
-                             1 << width, 1 << height, pMaskPicture->format,
+                             1 << width, 1 << height,
+                             (a8) ? VIA_FMT_A8_INTENSITY : pMaskPicture->format,
                              via_repeat, via_repeat,
                              ((pMaskPicture->componentAlpha)
-                              ? via_comp_mask : via_mask), isAGP)) {
+                              ? ((compOutReverse)
+                                 ? via_comp_mask_alpha : via_comp_mask)
+                              : via_mask), isAGP)) {
             return FALSE;
         }
+        v3d->setTexTransform(v3d, curTex, pMaskPicture->transform,
+                             pMaskPicture->filter == PictFilterBilinear);
         curTex++;
     }
 
     v3d->setFlags(v3d, curTex, FALSE, TRUE, TRUE);
     v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
-    v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0, pDst->drawable.width,
-                      pDst->drawable.height);
+    v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0,
+                      min(pDst->drawable.width, VIA_3D_MAX_DIM),
+                      min(pDst->drawable.height, VIA_3D_MAX_DIM));
+
+    return TRUE;
+}
+
+Bool
+viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
+                            PicturePtr pMaskPicture, PicturePtr pDstPicture,
+                            PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst)
+{
+    VIAPtr pVia = VIAPTR(xf86ScreenToScrn(pDst->drawable.pScreen));
+
+    if (!viaExaDoPrepareComposite_H2(op, pSrcPicture, pMaskPicture,
+                                    pDstPicture, pSrc, pMask, pDst)) {
+        viaExaCompositeReject(pVia, VIA_REJECT_PREPARE, op, pSrcPicture,
+                              pMaskPicture, pDstPicture);
+        return FALSE;
+    }
 
+    pVia->compStats.accelOps++;
     return TRUE;
 }
 
@@ -453,12 +584,23 @@ viaExaComposite_H2(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
     Via3DState *v3d = &pVia->v3d;
     CARD32 col;
 
+    pVia->compStats.accelPixels += width * height;
+
+    if (pVia->compositeFill) {
+        viaAccelSolidHelper_H2(pVia, exaGetPixmapOffset(pDst),
+                                exaGetPixmapPitch(pDst), dstX, dstY,
+                                width, height);
+        return;
+    }
+
     if (pVia->maskP) {
         viaPixelARGB8888(pVia->maskFormat, pVia->maskP, &col);
         v3d->setTexBlendCol(v3d, 0, pVia->componentAlpha, col);
     }
     if (pVia->srcP) {
         viaPixelARGB8888(pVia->srcFormat, pVia->srcP, &col);
+        if (pVia->dstFormat == PICT_a8)
+            col = (col >> 24) * 0x01010101;
         v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, col & 0x00FFFFFF, col >> 24);
         srcX = maskX;
         srcY = maskY;
@@ -467,10 +609,37 @@ viaExaComposite_H2(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
     if (pVia->maskP || pVia->srcP)
         v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
 
+    if (pVia->dstFormat == PICT_a8) {
+        viaExaCompositeA8(pDst, srcX, srcY, maskX, maskY, dstX, dstY,
+                          width, height);
+        return;
+    }
+
+    if ((dstX + width > VIA_3D_MAX_DIM) || (dstY + height > VIA_3D_MAX_DIM)) {
+        viaExaCompositeTiled(pDst, srcX, srcY, maskX, maskY, dstX, dstY,
+                             width, height);
+        return;
+    }
+
     v3d->emitQuad(pVia, v3d, &pVia->cb, dstX, dstY, srcX, srcY, maskX, maskY,
                   width, height);
 }
 
+/*
+ * The quads of one composite batch, like a run of glyphs from the EXA
+ * glyph cache, go out together.
+ */
+void
+viaExaDoneComposite_H2(PixmapPtr pDst)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    RING_VARS;
+
+    ADVANCE_RING;
+}
+
 void
 viaAccelTextureBlit(ScrnInfoPtr pScrn, unsigned long srcOffset,
                     unsigned srcPitch, unsigned w, unsigned h, unsigned srcX,
@@ -494,4 +663,5 @@ viaAccelTextureBlit(ScrnInfoPtr pScrn, unsigned long srcOffset,
     v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
     v3d->emitClipRect(pVia, v3d, &pVia->cb, dstX, dstY, w, h);
     v3d->emitQuad(pVia, v3d, &pVia->cb, dstX, dstY, srcX, srcY, 0, 0, w, h);
+    pVia->cb.flushFunc(pVia, &pVia->cb);
 }
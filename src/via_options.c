@@ -32,6 +32,8 @@
 #include "config.h"
 #endif
 
+#include <stdio.h>
+
 #include "via_driver.h"
 
 
@@ -43,7 +45,11 @@ typedef enum
     OPTION_NOACCEL,
     OPTION_EXA_NOCOMPOSITE,
     OPTION_EXA_SCRATCH_SIZE,
+    OPTION_EXA_CALIBRATE,
+    OPTION_EXA_CALIBRATION_CACHE,
+    OPTION_COMMAND_TRACE,
     OPTION_SWCURSOR,
+    OPTION_MAX_FRONT_BUFFER,
     OPTION_SHADOW_FB,
     OPTION_ROTATION_TYPE,
     OPTION_ROTATE,
@@ -59,6 +65,8 @@ typedef enum
     OPTION_XV_DMA,
     OPTION_MAX_DRIMEM,
     OPTION_AGPMEM,
+    OPTION_ASYNC_SUBMIT,
+    OPTION_ENGINE_LOAD,
     OPTION_DISABLE_XV_BW_CHECK
 } VIAOpts;
 
@@ -66,7 +74,11 @@ static OptionInfoRec VIAOptions[] = {
     {OPTION_NOACCEL,             "NoAccel",          OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_EXA_NOCOMPOSITE,     "ExaNoComposite",   OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_EXA_SCRATCH_SIZE,    "ExaScratchSize",   OPTV_INTEGER, {0}, FALSE},
+    {OPTION_EXA_CALIBRATE,       "ExaCalibrate",     OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_EXA_CALIBRATION_CACHE, "ExaCalibrationCache", OPTV_ANYSTR, {0}, FALSE},
+    {OPTION_COMMAND_TRACE,       "CommandTrace",     OPTV_ANYSTR,  {0}, FALSE},
     {OPTION_SWCURSOR,            "SWCursor",         OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_MAX_FRONT_BUFFER,    "MaxFrontBuffer",   OPTV_ANYSTR,  {0}, FALSE},
     {OPTION_SHADOW_FB,           "ShadowFB",         OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_ROTATION_TYPE,       "RotationType",     OPTV_ANYSTR,  {0}, FALSE},
     {OPTION_ROTATE,              "Rotate",           OPTV_ANYSTR,  {0}, FALSE},
@@ -82,6 +94,8 @@ static OptionInfoRec VIAOptions[] = {
     {OPTION_DISABLE_XV_BW_CHECK, "DisableXvBWCheck", OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_MAX_DRIMEM,          "MaxDRIMem",        OPTV_INTEGER, {0}, FALSE},
     {OPTION_AGPMEM,              "AGPMem",           OPTV_INTEGER, {0}, FALSE},
+    {OPTION_ASYNC_SUBMIT,        "AsyncSubmit",      OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_ENGINE_LOAD,         "EngineLoad",       OPTV_INTEGER, {0}, FALSE},
     {-1,                         NULL,               OPTV_NONE,    {0}, FALSE}
 };
 
@@ -105,12 +119,22 @@ viaSetupDefaultOptions(ScrnInfoPtr pScrn)
     pVia->noComposite = FALSE;
     pVia->useEXA = TRUE;
     pVia->exaScratchSize = VIA_SCRATCH_SIZE / 1024;
+    pVia->minComposite = VIA_MIN_COMPOSITE;
+    pVia->minTexUpload = VIA_MIN_TEX_UPLOAD;
+    pVia->minDownload = VIA_MIN_DOWNLOAD;
+    pVia->exaCalibrate = FALSE;
+    pVia->exaCalibrationCache = NULL;
+    pVia->cmdTraceFile = NULL;
     pVia->drmmode.hwcursor = TRUE;
+    pVia->maxFrontWidth = 0;
+    pVia->maxFrontHeight = 0;
     pVia->VQEnable = TRUE;
     pVia->DRIIrqEnable = TRUE;
     pVia->agpEnable = TRUE;
     pVia->dma2d = TRUE;
     pVia->dmaXV = TRUE;
+    pVia->asyncSubmit = FALSE;
+    pVia->engineLoadPeriod = 0;
 #ifdef HAVE_DEBUG
     pVia->disableXvBWCheck = FALSE;
 #endif
@@ -237,6 +261,19 @@ viaProcessUMSOptions(ScrnInfoPtr pScrn)
                     (pVia->dma2d) ? "" : "not ");
     }
 
+    from = xf86GetOptValBool(VIAOptions, OPTION_ASYNC_SUBMIT,
+                             &pVia->asyncSubmit) ? X_CONFIG : X_DEFAULT;
+#ifndef HAVE_PTHREAD
+    if (pVia->asyncSubmit) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "AsyncSubmit needs a driver built with POSIX threads.\n");
+        pVia->asyncSubmit = FALSE;
+    }
+#endif
+    xf86DrvMsg(pScrn->scrnIndex, from,
+                "Command buffers will %sbe submitted from a separate "
+                "thread.\n", (pVia->asyncSubmit) ? "" : "not ");
+
 /*
     pVia->dmaXV = TRUE;
 */
@@ -294,6 +331,16 @@ viaProcessUMSOptions(ScrnInfoPtr pScrn)
                 "Will try to allocate %d KB of AGP memory.\n",
                 pVia->agpMem);
 
+    if (xf86GetOptValInteger(VIAOptions, OPTION_ENGINE_LOAD,
+                             &pVia->engineLoadPeriod)) {
+        if (pVia->engineLoadPeriod < 0)
+            pVia->engineLoadPeriod = 0;
+        if (pVia->engineLoadPeriod)
+            xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                        "Reporting engine load every %d seconds.\n",
+                        pVia->engineLoadPeriod);
+    }
+
     pVIADisplay->TVDotCrawl = FALSE;
     from = xf86GetOptValBool(VIAOptions,
                                 OPTION_TVDOTCRAWL,
@@ -523,6 +570,29 @@ viaProcessOptions(ScrnInfoPtr pScrn)
             xf86DrvMsg(pScrn->scrnIndex, from,
                         "EXA scratch area size is %d KB.\n",
                         pVia->exaScratchSize);
+
+            from = xf86GetOptValBool(VIAOptions,
+                                        OPTION_EXA_CALIBRATE,
+                                        &pVia->exaCalibrate) ?
+                    X_CONFIG : X_DEFAULT;
+            xf86DrvMsg(pScrn->scrnIndex, from,
+                        "EXA offload threshold calibration %s.\n",
+                        pVia->exaCalibrate ? "enabled" : "disabled");
+
+            pVia->exaCalibrationCache =
+                    xf86GetOptValString(VIAOptions,
+                                        OPTION_EXA_CALIBRATION_CACHE);
+            if (pVia->exaCalibrationCache)
+                xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                            "EXA calibration cache is %s.\n",
+                            pVia->exaCalibrationCache);
+
+            pVia->cmdTraceFile =
+                    xf86GetOptValString(VIAOptions, OPTION_COMMAND_TRACE);
+            if (pVia->cmdTraceFile)
+                xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                            "Tracing command buffers to %s.\n",
+                            pVia->cmdTraceFile);
         }
     }
 
@@ -547,6 +617,29 @@ viaProcessOptions(ScrnInfoPtr pScrn)
         xf86DrvMsg(pScrn->scrnIndex, from,
                     "Using software cursors.\n");
 
+    /*
+     * Reserve a front buffer large enough for the given screen size,
+     * so that RandR resizes up to it need no new allocation.
+     */
+    if ((s = xf86GetOptValString(VIAOptions, OPTION_MAX_FRONT_BUFFER))) {
+        if ((sscanf(s, "%dx%d", &pVia->maxFrontWidth,
+                    &pVia->maxFrontHeight) == 2) &&
+            (pVia->maxFrontWidth > 0) && (pVia->maxFrontHeight > 0)) {
+            xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                        "Reserving a %dx%d front buffer.\n",
+                        pVia->maxFrontWidth, pVia->maxFrontHeight);
+        } else {
+            pVia->maxFrontWidth = 0;
+            pVia->maxFrontHeight = 0;
+            xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                        "\"%s\" is not a valid value for "
+                        "Option \"MaxFrontBuffer\".\n", s);
+            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                        "The value should be given as "
+                        "\"<width>x<height>\".\n");
+        }
+    }
+
     if (!pVia->KMS) {
         viaProcessUMSOptions(pScrn);
     }
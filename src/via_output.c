@@ -205,16 +205,29 @@ viaInitDisplay(ScrnInfoPtr pScrn)
     /* Initialize the number of TV connectors. */
     pVIADisplay->numberTV = 0;
 
+    /*
+     * The probes below cannot be overlapped.  All three I2C buses
+     * are bit-banged through sequencer registers (SR26, SR31, and
+     * SR2C) behind the single 3C4h / 3C5h index / data port pair,
+     * and each probe claims I2C buses in mappedI2CBus that the
+     * following probes rely on.
+     */
     viaExtTMDSProbe(pScrn);
+    viaBootPhaseEnd(pScrn, "External TMDS probe");
+
     viaTMDSProbe(pScrn);
+    viaBootPhaseEnd(pScrn, "Integrated TMDS probe");
 
     viaFPProbe(pScrn);
+    viaBootPhaseEnd(pScrn, "FP probe");
 
     viaAnalogProbe(pScrn);
+    viaBootPhaseEnd(pScrn, "Analog probe");
 
 
     /* TV */
     via_tv_init(pScrn);
+    viaBootPhaseEnd(pScrn, "TV encoder detection");
 
     /* DVI */
     viaExtTMDSInit(pScrn);
@@ -225,6 +238,7 @@ viaInitDisplay(ScrnInfoPtr pScrn)
 
     /* FP (Flat Panel) */
     viaFPInit(pScrn);
+    viaBootPhaseEnd(pScrn, "Output initialization");
 
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting viaInitDisplay.\n"));
@@ -0,0 +1,77 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Static tracing probes, in the "openchrome" provider. When configure
+ * finds <sys/sdt.h>, each probe is a single no-op instruction plus an ELF
+ * note that perf, bpftrace or SystemTap can attach to at run time, for
+ * example
+ *
+ *   bpftrace -l 'usdt:/usr/lib/xorg/modules/drivers/openchrome_drv.so:*'
+ *
+ * Otherwise the probes compile to nothing. Each traced operation has a
+ * start and a done probe, so that its latency can be measured:
+ *
+ *   flush__start(path, words, reason)  command buffer flush; path is a
+ *                                      VIA_TRACE_PATH_*, reason a
+ *                                      VIA_FLUSH_* value
+ *   flush__done(path)
+ *   sync__start()                      wait for all engines idle
+ *   sync__done()
+ *   marker__start(marker)              wait for an EXA marker
+ *   marker__done(marker)
+ *   download__start(w, h, bpp)         EXA download from the screen
+ *   download__done(ok)
+ *   putimage__start(port, fourcc, width, height)
+ *                                      Xv PutImage; port is the port
+ *                                      private pointer
+ *   putimage__done(port, status)
+ *   dmablit__start(fourcc, width, height)
+ *                                      Xv upload by PCI DMA
+ *   dmablit__done(err)
+ *   flip__start(fourcc, buffer)        Xv flip to a new frame
+ *   flip__done()
+ *   overlay__start(flags)              VIAVidUpdateOverlay; flags are
+ *                                      the DDOVER_* update flags
+ *   overlay__done(ok)
+ */
+
+#ifndef _VIA_PROBES_H_
+#define _VIA_PROBES_H_
+
+#ifdef HAVE_PROBES
+#include <sys/sdt.h>
+
+#define VIA_PROBE(name)                 DTRACE_PROBE(openchrome, name)
+#define VIA_PROBE1(name, a)             DTRACE_PROBE1(openchrome, name, a)
+#define VIA_PROBE2(name, a, b)          DTRACE_PROBE2(openchrome, name, a, b)
+#define VIA_PROBE3(name, a, b, c)       DTRACE_PROBE3(openchrome, name, a, b, c)
+#define VIA_PROBE4(name, a, b, c, d)    \
+    DTRACE_PROBE4(openchrome, name, a, b, c, d)
+#else
+#define VIA_PROBE(name)                 do { } while (0)
+#define VIA_PROBE1(name, a)             do { } while (0)
+#define VIA_PROBE2(name, a, b)          do { } while (0)
+#define VIA_PROBE3(name, a, b, c)       do { } while (0)
+#define VIA_PROBE4(name, a, b, c, d)    do { } while (0)
+#endif
+
+#endif /* _VIA_PROBES_H_ */
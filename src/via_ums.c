@@ -1364,6 +1364,8 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
         goto exit;
     }
 
+    viaBootPhaseEnd(pScrn, "VRAM probe");
+
     /* Split the FB for SAMM. */
     /* FIXME: For now, split the FB into two equal sections.
      * This should be user-adjustable via a config option. */
@@ -1398,6 +1400,8 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
 
     viaSaveOriginalRegisters(pScrn);
 
+    viaBootPhaseEnd(pScrn, "MMIO map");
+
     /* Read memory bandwidth from registers. */
     pVia->MemClk = hwp->readCrtc(hwp, 0x3D) >> 4;
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
@@ -1445,6 +1449,8 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
         goto free_mmio;
     }
 
+    viaBootPhaseEnd(pScrn, "I2C initialization");
+
     /*
      * Set up ClockRanges, which describe what clock ranges are
      * available, and what sort of modes they can be used for.
@@ -1533,6 +1539,7 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
     viaInitDisplay(pScrn);
 
     status = xf86InitialConfiguration(pScrn, TRUE);
+    viaBootPhaseEnd(pScrn, "Initial configuration");
     goto exit;
 free_mmio:
     viaUnmapMMIO(pScrn);
@@ -232,6 +232,7 @@ typedef struct _VIADISPLAY {
     Bool                isOLPCXO15;
 
     VIARegRec           SavedReg;
+    VIARegShadowRec     regShadow;
 
     CARD32      Clock; /* register value for the dotclock */
     Bool        ClockExternal;
@@ -70,6 +70,166 @@ ViaGrMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask)
     hwp->writeGr(hwp, index, tmp);
 }
 
+/*
+ * Registers that must always go straight to the hardware: the
+ * bit-banged I2C buses (SR26, SR2C, SR31) and the PLL reset
+ * (SR40), whose values change underneath us or whose writes
+ * have side effects even when the value is unchanged.
+ */
+static Bool
+viaRegShadowSeqBypass(CARD8 index)
+{
+    switch (index) {
+    case 0x26:
+    case 0x2C:
+    case 0x31:
+    case 0x40:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+#define VIA_SHADOW_VALID(valid, index) \
+    ((valid)[(index) >> 5] & (1U << ((index) & 0x1F)))
+
+#define VIA_SHADOW_SET_VALID(valid, index) \
+    (valid)[(index) >> 5] |= (1U << ((index) & 0x1F))
+
+static VIARegShadowPtr
+viaRegShadow(vgaHWPtr hwp)
+{
+    VIAPtr pVia = VIAPTR(hwp->pScrn);
+
+    return &pVia->pVIADisplay->regShadow;
+}
+
+static CARD8
+viaShadowReadCrtc(vgaHWPtr hwp, CARD8 index)
+{
+    VIARegShadowPtr shadow = viaRegShadow(hwp);
+
+    if (!VIA_SHADOW_VALID(shadow->CRValid, index)) {
+        shadow->CR[index] = shadow->readCrtc(hwp, index);
+        VIA_SHADOW_SET_VALID(shadow->CRValid, index);
+    }
+
+    return shadow->CR[index];
+}
+
+static void
+viaShadowWriteCrtc(vgaHWPtr hwp, CARD8 index, CARD8 value)
+{
+    VIARegShadowPtr shadow = viaRegShadow(hwp);
+
+    if (VIA_SHADOW_VALID(shadow->CRValid, index) &&
+        (shadow->CR[index] == value)) {
+        shadow->skipped++;
+        return;
+    }
+
+    shadow->writeCrtc(hwp, index, value);
+    shadow->CR[index] = value;
+    VIA_SHADOW_SET_VALID(shadow->CRValid, index);
+    shadow->writes++;
+}
+
+static CARD8
+viaShadowReadSeq(vgaHWPtr hwp, CARD8 index)
+{
+    VIARegShadowPtr shadow = viaRegShadow(hwp);
+
+    if (viaRegShadowSeqBypass(index)) {
+        return shadow->readSeq(hwp, index);
+    }
+
+    if (!VIA_SHADOW_VALID(shadow->SRValid, index)) {
+        shadow->SR[index] = shadow->readSeq(hwp, index);
+        VIA_SHADOW_SET_VALID(shadow->SRValid, index);
+    }
+
+    return shadow->SR[index];
+}
+
+static void
+viaShadowWriteSeq(vgaHWPtr hwp, CARD8 index, CARD8 value)
+{
+    VIARegShadowPtr shadow = viaRegShadow(hwp);
+
+    if (viaRegShadowSeqBypass(index)) {
+        shadow->writeSeq(hwp, index, value);
+        shadow->writes++;
+        return;
+    }
+
+    if (VIA_SHADOW_VALID(shadow->SRValid, index) &&
+        (shadow->SR[index] == value)) {
+        shadow->skipped++;
+        return;
+    }
+
+    shadow->writeSeq(hwp, index, value);
+    shadow->SR[index] = value;
+    VIA_SHADOW_SET_VALID(shadow->SRValid, index);
+    shadow->writes++;
+}
+
+/*
+ * Routes CR and SR accesses through the register shadow until the
+ * matching viaRegShadowEnd().  Calls may nest; only the outermost
+ * pair installs and removes the shadow.
+ */
+void
+viaRegShadowBegin(ScrnInfoPtr pScrn)
+{
+    vgaHWPtr hwp = VGAHWPTR(pScrn);
+    VIARegShadowPtr shadow = &VIAPTR(pScrn)->pVIADisplay->regShadow;
+
+    if (shadow->depth++) {
+        return;
+    }
+
+    memset(shadow->CRValid, 0, sizeof(shadow->CRValid));
+    memset(shadow->SRValid, 0, sizeof(shadow->SRValid));
+    shadow->writes = 0;
+    shadow->skipped = 0;
+
+    shadow->readCrtc = hwp->readCrtc;
+    shadow->writeCrtc = hwp->writeCrtc;
+    shadow->readSeq = hwp->readSeq;
+    shadow->writeSeq = hwp->writeSeq;
+
+    hwp->readCrtc = viaShadowReadCrtc;
+    hwp->writeCrtc = viaShadowWriteCrtc;
+    hwp->readSeq = viaShadowReadSeq;
+    hwp->writeSeq = viaShadowWriteSeq;
+}
+
+/*
+ * Restores direct register access.  The shadow contents are dropped
+ * since anything outside the shadowed section may change the
+ * hardware state.
+ */
+void
+viaRegShadowEnd(ScrnInfoPtr pScrn, const char *what)
+{
+    vgaHWPtr hwp = VGAHWPTR(pScrn);
+    VIARegShadowPtr shadow = &VIAPTR(pScrn)->pVIADisplay->regShadow;
+
+    if ((shadow->depth == 0) || (--shadow->depth)) {
+        return;
+    }
+
+    hwp->readCrtc = shadow->readCrtc;
+    hwp->writeCrtc = shadow->writeCrtc;
+    hwp->readSeq = shadow->readSeq;
+    hwp->writeSeq = shadow->writeSeq;
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 4,
+                    "%s: %u register writes, %u skipped.\n",
+                    what, shadow->writes, shadow->skipped);
+}
+
 #ifdef HAVE_DEBUG
 void
 ViaVgahwPrint(vgaHWPtr hwp)
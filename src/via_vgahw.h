@@ -25,9 +25,35 @@
 
 #include "vgaHW.h"
 
+/*
+ * Write-through shadow of the CR and SR register spaces, active for
+ * the duration of a mode set.  Reads are served from the shadow once
+ * a register has been read or written, and writes of the value the
+ * register already holds are dropped.  Writes that do go out are
+ * issued in program order.
+ */
+typedef struct _VIARegShadow {
+    int         depth;
+
+    CARD8       (*readCrtc)(vgaHWPtr hwp, CARD8 index);
+    void        (*writeCrtc)(vgaHWPtr hwp, CARD8 index, CARD8 value);
+    CARD8       (*readSeq)(vgaHWPtr hwp, CARD8 index);
+    void        (*writeSeq)(vgaHWPtr hwp, CARD8 index, CARD8 value);
+
+    CARD8       CR[256];
+    CARD8       SR[256];
+    CARD32      CRValid[256 / 32];
+    CARD32      SRValid[256 / 32];
+
+    unsigned    writes;
+    unsigned    skipped;
+} VIARegShadowRec, *VIARegShadowPtr;
+
 void ViaCrtcMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask);
 void ViaSeqMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask);
 void ViaGrMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask);
+void viaRegShadowBegin(ScrnInfoPtr pScrn);
+void viaRegShadowEnd(ScrnInfoPtr pScrn, const char *what);
 
 #ifdef HAVE_DEBUG
 void ViaVgahwPrint(vgaHWPtr hwp);
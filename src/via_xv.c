@@ -30,6 +30,8 @@
 #include "config.h"
 #endif
 
+#include <stdlib.h>
+
 #include "xf86.h"
 
 #if GET_ABI_MAJOR(ABI_VIDEODRV_VERSION) < 6
@@ -45,6 +47,7 @@
 #include "fourcc.h"
 
 #include "via_eng_regs.h"
+#include "via_probes.h"
 
 /*
  * D E F I N E
@@ -113,6 +116,16 @@ static void nv12Blit(unsigned char *nv12Chroma,
 static Atom xvBrightness, xvContrast, xvColorKey, xvHue, xvSaturation,
     xvAutoPaint;
 
+/* Statistics reported for each PutImage stage, in microseconds. */
+enum
+{ VIA_XV_STAT_MEAN = 0,
+    VIA_XV_STAT_P95,
+    VIA_XV_STAT_MAX,
+    VIA_XV_NUM_STATS
+};
+
+static Atom xvStat[VIA_XV_NUM_STAGES][VIA_XV_NUM_STATS], xvStatDropped;
+
 /*
  *  S T R U C T S
  */
@@ -135,7 +148,8 @@ static XF86VideoFormatRec FormatsG[NUM_FORMATS_G] = {
     {24, DirectColor}
 };
 
-#define NUM_ATTRIBUTES_G 6
+#define NUM_ATTRIBUTES_G 25
+#define FIRST_STAT_ATTRIBUTE 6
 
 static char attributeXvColorkey[] = { "XV_COLORKEY" };
 static char attributeXvBrightness[] = { "XV_BRIGHTNESS" };
@@ -145,13 +159,53 @@ static char attributeXvHue[] = { "XV_HUE" };
 static char attributeXvAutopaintColorkey[] =
                                         { "XV_AUTOPAINT_COLORKEY" };
 
+/* The order of these follows the stages and the VIA_XV_STAT_* kinds. */
+static char attributeXvStatSurfaceMean[] = { "XV_STAT_SURFACE_MEAN" };
+static char attributeXvStatSurfaceP95[] = { "XV_STAT_SURFACE_P95" };
+static char attributeXvStatSurfaceMax[] = { "XV_STAT_SURFACE_MAX" };
+static char attributeXvStatCopyMean[] = { "XV_STAT_COPY_MEAN" };
+static char attributeXvStatCopyP95[] = { "XV_STAT_COPY_P95" };
+static char attributeXvStatCopyMax[] = { "XV_STAT_COPY_MAX" };
+static char attributeXvStatBandwidthMean[] = { "XV_STAT_BANDWIDTH_MEAN" };
+static char attributeXvStatBandwidthP95[] = { "XV_STAT_BANDWIDTH_P95" };
+static char attributeXvStatBandwidthMax[] = { "XV_STAT_BANDWIDTH_MAX" };
+static char attributeXvStatFlipMean[] = { "XV_STAT_FLIP_MEAN" };
+static char attributeXvStatFlipP95[] = { "XV_STAT_FLIP_P95" };
+static char attributeXvStatFlipMax[] = { "XV_STAT_FLIP_MAX" };
+static char attributeXvStatOverlayMean[] = { "XV_STAT_OVERLAY_MEAN" };
+static char attributeXvStatOverlayP95[] = { "XV_STAT_OVERLAY_P95" };
+static char attributeXvStatOverlayMax[] = { "XV_STAT_OVERLAY_MAX" };
+static char attributeXvStatTotalMean[] = { "XV_STAT_TOTAL_MEAN" };
+static char attributeXvStatTotalP95[] = { "XV_STAT_TOTAL_P95" };
+static char attributeXvStatTotalMax[] = { "XV_STAT_TOTAL_MAX" };
+static char attributeXvStatDropped[] = { "XV_STAT_DROPPED" };
+
 static XF86AttributeRec AttributesG[NUM_ATTRIBUTES_G] = {
     {XvSettable | XvGettable,      0,  (1 << 24) - 1,          attributeXvColorkey},
     {XvSettable | XvGettable,      0,          10000,          attributeXvBrightness},
     {XvSettable | XvGettable,      0,          20000,          attributeXvContrast},
     {XvSettable | XvGettable,      0,          20000,          attributeXvSaturation},
     {XvSettable | XvGettable,   -180,            180,                 attributeXvHue},
-    {XvSettable | XvGettable,      0,              1,   attributeXvAutopaintColorkey}
+    {XvSettable | XvGettable,      0,              1,   attributeXvAutopaintColorkey},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatSurfaceMean},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatSurfaceP95},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatSurfaceMax},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatCopyMean},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatCopyP95},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatCopyMax},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatBandwidthMean},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatBandwidthP95},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatBandwidthMax},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatFlipMean},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatFlipP95},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatFlipMax},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatOverlayMean},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatOverlayP95},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatOverlayMax},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatTotalMean},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatTotalP95},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatTotalMax},
+    {XvGettable,                   0,     0x7fffffff,          attributeXvStatDropped}
 };
 
 #define NUM_IMAGES_G 7
@@ -463,6 +517,64 @@ viaXvError(ScrnInfoPtr pScrn, viaPortPrivPtr pPriv, XvError error)
             pPriv->xv_portnum, viaXvErrMsg[error]);
 }
 
+static void
+viaXvStatAdd(viaXvStageStatRec *stat, CARD64 usec)
+{
+    stat->usec[stat->next] = (usec > 0xffffffff) ? 0xffffffff : usec;
+    stat->next = (stat->next + 1) % VIA_XV_STAT_FRAMES;
+    if (stat->count < VIA_XV_STAT_FRAMES)
+        stat->count++;
+}
+
+/*
+ * Record the time since the previous stage of this PutImage ended.
+ */
+static void
+viaXvStageDone(viaPortPrivPtr pPriv, int stage)
+{
+    CARD64 now = viaTimeUsec();
+
+    viaXvStatAdd(&pPriv->stageStats[stage], now - pPriv->stageStart);
+    pPriv->stageStart = now;
+}
+
+static int
+viaXvStatCompare(const void *a, const void *b)
+{
+    CARD32 x = *(const CARD32 *)a, y = *(const CARD32 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static INT32
+viaXvStatValue(const viaXvStageStatRec *stat, int kind)
+{
+    CARD32 sorted[VIA_XV_STAT_FRAMES];
+    CARD64 sum = 0;
+    CARD32 max = 0;
+    unsigned i;
+
+    if (!stat->count)
+        return 0;
+
+    switch (kind) {
+    case VIA_XV_STAT_MEAN:
+        for (i = 0; i < stat->count; i++)
+            sum += stat->usec[i];
+        return sum / stat->count;
+    case VIA_XV_STAT_P95:
+        /* Nearest rank. */
+        memcpy(sorted, stat->usec, stat->count * sizeof(CARD32));
+        qsort(sorted, stat->count, sizeof(CARD32), viaXvStatCompare);
+        return sorted[(stat->count * 95 + 99) / 100 - 1];
+    default:
+        for (i = 0; i < stat->count; i++)
+            if (stat->usec[i] > max)
+                max = stat->usec[i];
+        return max;
+    }
+}
+
 static void
 viaResetVideo(ScrnInfoPtr pScrn)
 {
@@ -725,6 +837,15 @@ viaSetupAdaptors(ScreenPtr pScreen, XF86VideoAdaptorPtr ** adaptors)
     xvHue = MAKE_ATOM("XV_HUE");
     xvSaturation = MAKE_ATOM("XV_SATURATION");
     xvAutoPaint = MAKE_ATOM("XV_AUTOPAINT_COLORKEY");
+    for (i = 0; i < VIA_XV_NUM_STAGES; i++) {
+        for (j = 0; j < VIA_XV_NUM_STATS; j++) {
+            char *name = AttributesG[FIRST_STAT_ATTRIBUTE +
+                                     i * VIA_XV_NUM_STATS + j].name;
+
+            xvStat[i][j] = MakeAtom(name, strlen(name), TRUE);
+        }
+    }
+    xvStatDropped = MAKE_ATOM("XV_STAT_DROPPED");
 
     *adaptors = NULL;
     usedPorts = 0;
@@ -825,6 +946,8 @@ viaStopVideo(ScrnInfoPtr pScrn, pointer data, Bool exit)
         pPriv->old_drw_y = 0;
         pPriv->old_drw_w = 0;
         pPriv->old_drw_h = 0;
+        memset(pPriv->stageStats, 0, sizeof(pPriv->stageStats));
+        pPriv->droppedFrames = 0;
     }
 }
 
@@ -926,7 +1049,19 @@ viaGetPortAttribute(ScrnInfoPtr pScrn,
             DBG_DD(ErrorF("    xvHue = %08ld\n", *value));
         }
 
+    } else if (attribute == xvStatDropped) {
+        *value = pPriv->droppedFrames;
     } else {
+        int i, j;
+
+        for (i = 0; i < VIA_XV_NUM_STAGES; i++) {
+            for (j = 0; j < VIA_XV_NUM_STATS; j++) {
+                if (attribute == xvStat[i][j]) {
+                    *value = viaXvStatValue(&pPriv->stageStats[i], j);
+                    return Success;
+                }
+            }
+        }
         DBG_DD(ErrorF(" via_xv.c : viaGetPortAttribute : is not supported the attribute\n"));
         /*return BadMatch */;
     }
@@ -962,6 +1097,8 @@ Flip(VIAPtr pVia, viaPortPrivPtr pPriv, int fourcc,
         && !(pVia->swov.gdwVideoFlagSW & VIDEO_1_INUSE))
         proReg = PRO_HQV1_OFFSET;
 
+    VIA_PROBE2(flip__start, fourcc, DisplayBufferIndex);
+
     switch (fourcc) {
         case FOURCC_UYVY:
         case FOURCC_YUY2:
@@ -993,6 +1130,8 @@ Flip(VIAPtr pVia, viaPortPrivPtr pPriv, int fourcc,
             VIASETREG(HQV_CONTROL + proReg, (VIAGETREG(HQV_CONTROL + proReg) & ~HQV_FLIP_ODD) | HQV_SW_FLIP | HQV_FLIP_STATUS);
 	    break;
     }
+
+    VIA_PROBE(flip__done);
 }
 
 /*
@@ -1031,6 +1170,7 @@ viaDmaBlitImage(VIAPtr pVia,
     Bool bounceBuffer;
     drm_via_dmablit_t blit;
     drm_via_blitsync_t *chromaSync = &blit.sync;
+    CARD64 start;
     unsigned char *base;
     unsigned char *bounceBase;
     unsigned bounceStride;
@@ -1147,8 +1287,10 @@ viaDmaBlitImage(VIAPtr pVia,
             return -1;
     }
 
+    start = viaTimeUsec();
     while (-EAGAIN == (err = drmCommandWrite(pVia->drmmode.fd, DRM_VIA_BLIT_SYNC,
         chromaSync, sizeof(*chromaSync)))) ;
+    viaWaitAccount(pVia, VIA_WAIT_XV_DMA, start, FALSE);
     if (err < 0)
         return -1;
 
@@ -1173,7 +1315,7 @@ viaDmaBlitImage(VIAPtr pVia,
  */
 
 static int
-viaPutImage(ScrnInfoPtr pScrn,
+viaPutImageFrame(ScrnInfoPtr pScrn,
         short src_x, short src_y,
         short drw_x, short drw_y,
         short src_w, short src_h,
@@ -1230,6 +1372,7 @@ viaPutImage(ScrnInfoPtr pScrn,
                 viaXvError(pScrn, pPriv, xve_mem);
                 return retCode;
             }
+            viaXvStageDone(pPriv, VIA_XV_STAGE_SURFACE);
 
             /*  Copy image data from system memory to video memory
              *  TODO: use DRM's DMA feature to accelerate data copy
@@ -1239,9 +1382,14 @@ viaPutImage(ScrnInfoPtr pScrn,
 
                 if (pVia->useDmaBlit) {
 #ifdef OPENCHROMEDRI
-                    if (viaDmaBlitImage(pVia, pPriv, buf,
+                    int err;
+
+                    VIA_PROBE3(dmablit__start, id, width, height);
+                    err = viaDmaBlitImage(pVia, pPriv, buf,
                         (CARD32) pVia->swov.SWDevice.dwSWPhysicalAddr[pVia->dwFrameNum & 1],
-                        width, height, dstPitch, id)) {
+                        width, height, dstPitch, id);
+                    VIA_PROBE1(dmablit__done, err);
+                    if (err) {
                             viaXvError(pScrn, pPriv, xve_dmablit);
                         return BadAccess;
                     }
@@ -1286,6 +1434,7 @@ viaPutImage(ScrnInfoPtr pScrn,
                             break;
                     }
                 }
+                viaXvStageDone(pPriv, VIA_XV_STAGE_COPY);
             }
 
             /* If there is bandwidth issue, block the H/W overlay */
@@ -1296,6 +1445,7 @@ viaPutImage(ScrnInfoPtr pScrn,
                 viaXvError(pScrn, pPriv, xve_bandwidth);
                 return BadAlloc;
             }
+            viaXvStageDone(pPriv, VIA_XV_STAGE_BANDWIDTH);
 
             /*
              *  fill video overlay parameter
@@ -1330,6 +1480,7 @@ viaPutImage(ScrnInfoPtr pScrn,
 
                 DBG_DD(ErrorF("             : Flip\n"));
                 Flip(pVia, pPriv, id, pVia->dwFrameNum & 1);
+                viaXvStageDone(pPriv, VIA_XV_STAGE_FLIP);
             }
 
             pVia->dwFrameNum++;
@@ -1380,7 +1531,10 @@ viaPutImage(ScrnInfoPtr pScrn,
             if (!VIAVidUpdateOverlay(crtc, lpUpdateOverlay)) {
                 DBG_DD(ErrorF
                         (" via_xv.c : call v4l updateoverlay fail. \n"));
+                viaXvStageDone(pPriv, VIA_XV_STAGE_OVERLAY);
+                pPriv->droppedFrames++;
             } else {
+                viaXvStageDone(pPriv, VIA_XV_STAGE_OVERLAY);
                 DBG_DD(ErrorF(" via_xv.c : PutImage done OK\n"));
                 viaXvError(pScrn, pPriv, xve_none);
                 return Success;
@@ -1397,6 +1551,33 @@ viaPutImage(ScrnInfoPtr pScrn,
     return Success;
 }
 
+static int
+viaPutImage(ScrnInfoPtr pScrn,
+        short src_x, short src_y,
+        short drw_x, short drw_y,
+        short src_w, short src_h,
+        short drw_w, short drw_h,
+        int id, unsigned char *buf,
+        short width, short height, Bool sync, RegionPtr clipBoxes,
+        pointer data, DrawablePtr pDraw)
+{
+    viaPortPrivPtr pPriv = (viaPortPrivPtr) data;
+    CARD64 start;
+    int ret;
+
+    VIA_PROBE4(putimage__start, data, id, width, height);
+    start = pPriv->stageStart = viaTimeUsec();
+    ret = viaPutImageFrame(pScrn, src_x, src_y, drw_x, drw_y, src_w, src_h,
+                           drw_w, drw_h, id, buf, width, height, sync,
+                           clipBoxes, data, pDraw);
+    viaXvStatAdd(&pPriv->stageStats[VIA_XV_STAGE_TOTAL],
+                 viaTimeUsec() - start);
+    if (ret != Success)
+        pPriv->droppedFrames++;
+    VIA_PROBE2(putimage__done, data, ret);
+    return ret;
+}
+
 static int
 viaQueryImageAttributes(ScrnInfoPtr pScrn,
         int id, unsigned short *w, unsigned short *h, int *pitches,
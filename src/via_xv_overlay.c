@@ -40,6 +40,7 @@
 #include <unistd.h>
 
 #include "via_eng_regs.h"
+#include "via_probes.h"
 
 /*
  * Warning: this file contains revision checks which are CLE266-specific.
@@ -2271,6 +2272,8 @@ VIAVidUpdateOverlay(xf86CrtcPtr crtc, LPDDUPDATEOVERLAY pUpdate)
 
     unsigned long proReg = 0;
 
+    VIA_PROBE1(overlay__start, flags);
+
     panDX = pVia->swov.panning_x;
     panDY = pVia->swov.panning_y;
     pVia->swov.oldPanningX = pVia->swov.panning_x;
@@ -2403,11 +2406,14 @@ VIAVidUpdateOverlay(xf86CrtcPtr crtc, LPDDUPDATEOVERLAY pUpdate)
                    pVia->swov.SWDevice.dwPitch, ovlV1->dwV1OriWidth,
                    ovlV1->dwV1OriHeight, deinterlaceMode, haveColorKey,
                    haveChromaKey, colorKeyLow, colorKeyHigh, chromaKeyLow,
-                   chromaKeyHigh))
+                   chromaKeyHigh)) {
+        VIA_PROBE1(overlay__done, FALSE);
         return FALSE;
+    }
 
     pVia->swov.SWVideo_ON = FALSE;
 
+    VIA_PROBE1(overlay__done, TRUE);
     return TRUE;
 
 }  /* VIAVidUpdateOverlay */
@@ -71,6 +71,30 @@ typedef enum
 
 #define VIA_MAX_XV_PORTS 1
 
+/*
+ * Stages of a PutImage, timed for the read-only XV_STAT_* port
+ * attributes.
+ */
+enum
+{ VIA_XV_STAGE_SURFACE = 0,     /* Surface (re)creation. */
+    VIA_XV_STAGE_COPY,          /* CPU copy or DMA blit of the image. */
+    VIA_XV_STAGE_BANDWIDTH,     /* Memory bandwidth check. */
+    VIA_XV_STAGE_FLIP,
+    VIA_XV_STAGE_OVERLAY,       /* Colorkey and VIAVidUpdateOverlay. */
+    VIA_XV_STAGE_TOTAL,
+    VIA_XV_NUM_STAGES
+};
+
+/* Frames the statistics of each stage are taken over. */
+#define VIA_XV_STAT_FRAMES 128
+
+typedef struct
+{
+    CARD32 usec[VIA_XV_STAT_FRAMES];   /* Ring of the latest times. */
+    unsigned count;
+    unsigned next;
+} viaXvStageStatRec;
+
 typedef struct
 {
     unsigned char xv_adaptor;
@@ -108,6 +132,14 @@ typedef struct
     unsigned dmaBounceLines;
     XvError xvErr;
 
+    /*
+     * PutImage latency per stage, and frames that failed to reach the
+     * overlay.
+     */
+    viaXvStageStatRec stageStats[VIA_XV_NUM_STAGES];
+    CARD64 stageStart;
+    CARD32 droppedFrames;
+
 } viaPortPrivRec, *viaPortPrivPtr;
 
 /*
@@ -0,0 +1,335 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Model of the 2D engine, as driven by the openchrome EXA code: solid
+ * fills with a fixed color pattern, screen to screen copies in all four
+ * directions, raster operations, clipping and the byte plane mask, into
+ * a video memory image in RAM. Commands the model does not know, like
+ * mono sources, patterns from memory and color keys, are counted and
+ * skipped. The register layout is the one of the original 2D engine, or
+ * of the M1 engine of the VX800 and later.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "via_2dsim.h"
+
+/* GECMD bits. */
+#define GEC_CMD_MASK		0x0000000f
+#define GEC_BLT			0x00000001
+#define GEC_SRC_SYS		0x00000040
+#define GEC_SRC_MONO		0x00000100
+#define GEC_PAT_MONO		0x00000200
+#define GEC_CLIP_ENABLE		0x00001000
+#define GEC_FIXCOLOR_PAT	0x00002000
+#define GEC_DECY		0x00004000
+#define GEC_DECX		0x00008000
+
+/* GEMODE bits. */
+#define GEM_BPP_MASK		0x00000300
+#define GEM_16BPP		0x00000100
+#define GEM_32BPP		0x00000300
+
+enum sim_reg {
+	R_GECMD, R_GEMODE, R_SRCPOS, R_DSTPOS, R_DIMENSION, R_FGCOLOR,
+	R_CLIPTL, R_CLIPBR, R_KEYCONTROL, R_SRCBASE, R_DSTBASE, R_PITCH,
+	R_NUM
+};
+
+static const unsigned regs_h2[R_NUM] = {
+	0x000, 0x004, 0x008, 0x00c, 0x010, 0x018,
+	0x020, 0x024, 0x02c, 0x030, 0x034, 0x038
+};
+
+/* The M1 engine takes the fixed pattern color from 0x058. */
+static const unsigned regs_m1[R_NUM] = {
+	0x000, 0x004, 0x018, 0x010, 0x00c, 0x058,
+	0x040, 0x044, 0x048, 0x01c, 0x014, 0x008
+};
+
+struct via_2dsim {
+	uint8_t *vram;
+	size_t vram_size;
+	int8_t reg_index[0x400];
+	uint32_t regs[R_NUM];
+
+	uint64_t fills;
+	uint64_t copies;
+	uint64_t unsupported;
+	uint64_t out_of_range;
+	uint64_t markers;
+	uint32_t last_marker;
+	uint64_t pixels;
+	uint64_t nsec;
+};
+
+struct via_2dsim *
+sim_create(size_t vram_size, int m1)
+{
+	struct via_2dsim *sim = calloc(1, sizeof(*sim));
+	const unsigned *layout = m1 ? regs_m1 : regs_h2;
+	int i;
+
+	if (!sim)
+		return NULL;
+	sim->vram = calloc(1, vram_size);
+	if (!sim->vram) {
+		free(sim);
+		return NULL;
+	}
+	sim->vram_size = vram_size;
+
+	memset(sim->reg_index, -1, sizeof(sim->reg_index));
+	for (i = 0; i < R_NUM; i++)
+		sim->reg_index[layout[i] >> 2] = i;
+	return sim;
+}
+
+void
+sim_destroy(struct via_2dsim *sim)
+{
+	free(sim->vram);
+	free(sim);
+}
+
+/*
+ * Three-operand raster operation, bit by bit: bit (p << 2 | s << 1 | d)
+ * of the ROP code is the result for those pattern, source and
+ * destination bits.
+ */
+static uint32_t
+rop3(uint8_t rop, uint32_t p, uint32_t s, uint32_t d)
+{
+	uint32_t result = 0;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		if (rop & (1 << i))
+			result |= ((i & 4) ? p : ~p) & ((i & 2) ? s : ~s) &
+				  ((i & 1) ? d : ~d);
+	}
+	return result;
+}
+
+static uint32_t
+read_pixel(const uint8_t *p, int cpp)
+{
+	switch (cpp) {
+	case 1:
+		return p[0];
+	case 2:
+		return p[0] | (p[1] << 8);
+	default:
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+}
+
+static void
+write_pixel(uint8_t *p, int cpp, uint32_t value, unsigned keep_bytes)
+{
+	int i;
+
+	for (i = 0; i < cpp; i++) {
+		if (!(keep_bytes & (1 << i)))
+			p[i] = value >> (i * 8);
+	}
+}
+
+static int
+in_vram(struct via_2dsim *sim, uint64_t base, int x, int y, int pitch,
+	int cpp)
+{
+	uint64_t offset = base + (uint64_t)y * pitch + (uint64_t)x * cpp;
+
+	return offset + cpp <= sim->vram_size;
+}
+
+static void
+execute(struct via_2dsim *sim, uint32_t cmd)
+{
+	uint32_t *r = sim->regs;
+	int cpp, w, h, x, y, dx, dy, sx, sy, stepx, stepy, i, j;
+	int dst_pitch, src_pitch, clip_x1, clip_y1, clip_x2, clip_y2;
+	uint64_t dst_base, src_base;
+	unsigned keep_bytes = (r[R_KEYCONTROL] >> 28) & 0xf;
+	uint8_t rop = cmd >> 24;
+	int copy = !(cmd & GEC_FIXCOLOR_PAT);
+
+	if ((cmd & GEC_CMD_MASK) != GEC_BLT ||
+	    (cmd & (GEC_SRC_SYS | GEC_SRC_MONO | GEC_PAT_MONO)) ||
+	    (r[R_KEYCONTROL] & 0x0fffffff)) {
+		sim->unsupported++;
+		return;
+	}
+
+	switch (r[R_GEMODE] & GEM_BPP_MASK) {
+	case GEM_32BPP:
+		cpp = 4;
+		break;
+	case GEM_16BPP:
+		cpp = 2;
+		break;
+	default:
+		cpp = 1;
+		break;
+	}
+
+	w = (r[R_DIMENSION] & 0xfff) + 1;
+	h = ((r[R_DIMENSION] >> 16) & 0xfff) + 1;
+	dx = r[R_DSTPOS] & 0xffff;
+	dy = (r[R_DSTPOS] >> 16) & 0xffff;
+	sx = r[R_SRCPOS] & 0xffff;
+	sy = (r[R_SRCPOS] >> 16) & 0xffff;
+	dst_base = (uint64_t)r[R_DSTBASE] << 3;
+	src_base = (uint64_t)r[R_SRCBASE] << 3;
+	dst_pitch = ((r[R_PITCH] >> 16) & 0x7fff) << 3;
+	src_pitch = (r[R_PITCH] & 0x7fff) << 3;
+
+	clip_x1 = r[R_CLIPTL] & 0xffff;
+	clip_y1 = (r[R_CLIPTL] >> 16) & 0xffff;
+	clip_x2 = r[R_CLIPBR] & 0xffff;
+	clip_y2 = (r[R_CLIPBR] >> 16) & 0xffff;
+
+	/* The marker blit of MarkSync: one pixel without a pitch. */
+	if (!copy && w == 1 && h == 1 && dst_pitch == 0 && cpp == 4) {
+		sim->markers++;
+		sim->last_marker = r[R_FGCOLOR];
+	}
+
+	/* Decrementing blits start at the far corner. */
+	stepx = (cmd & GEC_DECX) ? -1 : 1;
+	stepy = (cmd & GEC_DECY) ? -1 : 1;
+
+	if (!in_vram(sim, dst_base, (stepx > 0) ? dx + w - 1 : dx,
+		     (stepy > 0) ? dy + h - 1 : dy, dst_pitch, cpp) ||
+	    (copy && !in_vram(sim, src_base, (stepx > 0) ? sx + w - 1 : sx,
+			      (stepy > 0) ? sy + h - 1 : sy, src_pitch,
+			      cpp)) ||
+	    (stepx < 0 && (dx - w + 1 < 0 || (copy && sx - w + 1 < 0))) ||
+	    (stepy < 0 && (dy - h + 1 < 0 || (copy && sy - h + 1 < 0)))) {
+		sim->out_of_range++;
+		return;
+	}
+
+	for (j = 0; j < h; j++) {
+		y = dy + j * stepy;
+		if ((cmd & GEC_CLIP_ENABLE) && (y < clip_y1 || y > clip_y2))
+			continue;
+		for (i = 0; i < w; i++) {
+			uint8_t *d;
+			uint32_t s = 0, value;
+
+			x = dx + i * stepx;
+			if ((cmd & GEC_CLIP_ENABLE) &&
+			    (x < clip_x1 || x > clip_x2))
+				continue;
+
+			d = sim->vram + dst_base + (uint64_t)y * dst_pitch +
+			    (uint64_t)x * cpp;
+			if (copy)
+				s = read_pixel(sim->vram + src_base +
+					       (uint64_t)(sy + j * stepy) *
+					       src_pitch +
+					       (uint64_t)(sx + i * stepx) * cpp,
+					       cpp);
+			value = rop3(rop, r[R_FGCOLOR], s, read_pixel(d, cpp));
+			write_pixel(d, cpp, value, keep_bytes);
+			sim->pixels++;
+		}
+	}
+
+	if (copy)
+		sim->copies++;
+	else
+		sim->fills++;
+}
+
+void
+sim_write(struct via_2dsim *sim, unsigned reg, uint32_t value)
+{
+	struct timespec t0, t1;
+	int index;
+
+	if (reg >= 0x1000)
+		return;
+	index = sim->reg_index[reg >> 2];
+	if (index < 0)
+		return;
+	sim->regs[index] = value;
+	if (index != R_GECMD)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	execute(sim, value);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	sim->nsec += (t1.tv_sec - t0.tv_sec) * 1000000000ULL +
+		     t1.tv_nsec - t0.tv_nsec;
+}
+
+/* The video memory image, for the caller to fill in and check. */
+uint8_t *
+sim_vram(struct via_2dsim *sim)
+{
+	return sim->vram;
+}
+
+/* FNV-1a hash of the video memory image, for regression checks. */
+static uint64_t
+checksum(const uint8_t *p, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+void
+sim_report(struct via_2dsim *sim, FILE *out)
+{
+	fprintf(out, "2D simulation: %llu fills, %llu copies, "
+		"%llu unsupported, %llu outside video memory\n",
+		(unsigned long long)sim->fills,
+		(unsigned long long)sim->copies,
+		(unsigned long long)sim->unsupported,
+		(unsigned long long)sim->out_of_range);
+	fprintf(out, "  %llu pixels", (unsigned long long)sim->pixels);
+	if (sim->nsec)
+		fprintf(out, ", %.1f Mpixels/s simulated",
+			sim->pixels * 1e3 / sim->nsec);
+	fprintf(out, "\n  %llu markers, last 0x%08x\n",
+		(unsigned long long)sim->markers, sim->last_marker);
+	fprintf(out, "  video memory checksum %016llx\n",
+		(unsigned long long)checksum(sim->vram, sim->vram_size));
+}
+
+int
+sim_dump(struct via_2dsim *sim, FILE *out)
+{
+	return fwrite(sim->vram, 1, sim->vram_size, out) == sim->vram_size
+		? 0 : -1;
+}
@@ -0,0 +1,37 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _VIA_2DSIM_H_
+#define _VIA_2DSIM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct via_2dsim;
+
+struct via_2dsim *sim_create(size_t vram_size, int m1);
+void sim_destroy(struct via_2dsim *sim);
+void sim_write(struct via_2dsim *sim, unsigned reg, uint32_t value);
+uint8_t *sim_vram(struct via_2dsim *sim);
+void sim_report(struct via_2dsim *sim, FILE *out);
+int sim_dump(struct via_2dsim *sim, FILE *out);
+
+#endif /* _VIA_2DSIM_H_ */
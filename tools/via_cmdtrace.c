@@ -0,0 +1,475 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Decoder for the command traces written by the openchrome driver with
+ * Option "CommandTrace". The command buffers are parsed the way the
+ * driver's MMIO path sends them: HALCYON_HEADER1 runs of register and
+ * value pairs for the 2D engine, and HALCYON_HEADER2 packets of SubA
+ * words or vertex data for the 3D engine. Optionally, the 2D commands
+ * are replayed on a model of the 2D engine, see via_2dsim.c.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "via_3d_reg.h"
+#include "via_cmdtrace.h"
+#include "via_2dsim.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* 2D registers with a special meaning in the command stream. */
+#define REG_GECMD	0x000	/* Starts the 2D command. */
+#define REG_ALIGN	0x2f8	/* Written to pad buffers for AGP DMA. */
+
+#define NUM_H1_REGS	0x400
+#define NUM_H2_UNITS	257	/* Non-texture state, then texture subtypes. */
+#define NUM_TOP		10
+
+struct stat_count {
+	uint64_t writes;
+	uint64_t redundant;
+};
+
+struct reg_state {
+	int valid;
+	uint32_t value;
+};
+
+struct trace_stats {
+	uint64_t records;
+	uint64_t reasons[2];
+	uint64_t paths[3];
+	uint64_t words;
+	uint64_t first_usec, last_usec;
+
+	/* Words by packet type, including headers. */
+	uint64_t h1_words;
+	uint64_t h2_words[256];
+	uint64_t h2_packets[256];
+	uint64_t dummy_words;
+	uint64_t align_writes;
+
+	/* 2D register writes and redundant writes. */
+	struct reg_state h1_state[NUM_H1_REGS];
+	struct stat_count h1_regs[NUM_H1_REGS];
+	uint64_t commands_2d;
+
+	/* 3D SubA writes, by texture unit, and vertex data. */
+	struct reg_state h2_state[NUM_H2_UNITS][256];
+	struct stat_count h2_regs[NUM_H2_UNITS][256];
+	uint64_t vertex_packets;
+	uint64_t vertex_words;
+	uint64_t fires;
+
+	uint64_t parse_errors;
+
+	struct via_2dsim *sim;
+};
+
+static const char *reason_names[] = { "submit", "full" };
+static const char *path_names[] = { "mmio", "agp", "pci" };
+
+static const char *
+para_type_name(unsigned type)
+{
+	switch (type) {
+	case HC_ParaType_CmdVdata:
+		return "vertex data";
+	case HC_ParaType_NotTex:
+		return "3D state";
+	case HC_ParaType_Tex:
+		return "texture state";
+	case HC_ParaType_Palette:
+		return "palette";
+	case HC_ParaType_PreCR:
+		return "pre-CR";
+	case HC_ParaType_Auto:
+		return "auto";
+	default:
+		return "unknown";
+	}
+}
+
+static void
+count_write(struct reg_state *state, struct stat_count *count,
+	    uint32_t value)
+{
+	count->writes++;
+	if (state->valid && state->value == value)
+		count->redundant++;
+	state->valid = 1;
+	state->value = value;
+}
+
+static int
+is_header(uint32_t word)
+{
+	return (word == HALCYON_HEADER2 ||
+		(word & HALCYON_HEADER1MASK) == HALCYON_HEADER1);
+}
+
+/*
+ * Unlike the driver, stop vertex data at the next header too, so that
+ * the following packets are decoded. Vertex coordinates are floats
+ * that are unlikely to look like headers.
+ */
+static void
+decode_buffer(struct trace_stats *st, const uint32_t *bp, uint32_t size,
+	      int verbose)
+{
+	const uint32_t *endp = bp + size;
+
+	while (bp < endp) {
+		if (*bp == HALCYON_HEADER2) {
+			const uint32_t *start = bp;
+			unsigned type, unit;
+
+			if (++bp == endp)
+				break;
+			type = (*bp >> 16) & 0xff;
+			unit = (type == HC_ParaType_Tex)
+				? 1 + ((*bp >> 24) & 0xff) : 0;
+			bp++;
+			st->h2_packets[type]++;
+
+			while (bp < endp && !is_header(*bp)) {
+				uint32_t word = *bp++;
+
+				if (word == HC_DUMMY) {
+					st->dummy_words++;
+					continue;
+				}
+				if (type == HC_ParaType_CmdVdata) {
+					if ((word & HALCYON_CMDBMASK) ==
+					    HALCYON_CMDB)
+						st->vertex_packets++;
+					else if ((word & HALCYON_FIREMASK) ==
+						 HALCYON_FIRECMD)
+						st->fires++;
+					else
+						st->vertex_words++;
+				} else if (type == HC_ParaType_NotTex ||
+					   type == HC_ParaType_Tex) {
+					unsigned subA = word >> HC_SubA_SHIFT;
+
+					count_write(&st->h2_state[unit][subA],
+						    &st->h2_regs[unit][subA],
+						    word & HC_Para_MASK);
+				}
+			}
+			st->h2_words[type] += bp - start;
+			if (verbose > 1)
+				printf("  H2 %-13s %5ld words\n",
+				       para_type_name(type), (long)(bp - start));
+		} else if ((*bp & HALCYON_HEADER1MASK) == HALCYON_HEADER1) {
+			const uint32_t *start = bp;
+
+			while (bp + 1 < endp && *bp != HALCYON_HEADER2) {
+				unsigned reg = *bp & ~HALCYON_HEADER1MASK;
+				uint32_t value = bp[1];
+
+				if ((*bp & HALCYON_HEADER1MASK) != HALCYON_HEADER1)
+					break;
+				bp += 2;
+				if (st->sim)
+					sim_write(st->sim, reg << 2, value);
+				if ((reg << 2) == REG_ALIGN) {
+					st->align_writes++;
+				} else if ((reg << 2) == REG_GECMD) {
+					st->commands_2d++;
+					st->h1_regs[reg].writes++;
+				} else {
+					count_write(&st->h1_state[reg],
+						    &st->h1_regs[reg], value);
+				}
+			}
+			st->h1_words += bp - start;
+			if (verbose > 1)
+				printf("  H1 %5ld words\n", (long)(bp - start));
+			if (bp == start) {
+				st->parse_errors++;
+				bp++;
+			}
+		} else {
+			st->parse_errors++;
+			bp++;
+		}
+	}
+}
+
+struct top_entry {
+	uint64_t redundant;
+	uint64_t writes;
+	unsigned unit;
+	unsigned reg;
+};
+
+static void
+insert_top(struct top_entry *top, const struct stat_count *count,
+	   unsigned unit, unsigned reg)
+{
+	int i, j;
+
+	if (!count->redundant)
+		return;
+	for (i = 0; i < NUM_TOP; i++) {
+		if (count->redundant > top[i].redundant)
+			break;
+	}
+	if (i == NUM_TOP)
+		return;
+	for (j = NUM_TOP - 1; j > i; j--)
+		top[j] = top[j - 1];
+	top[i].redundant = count->redundant;
+	top[i].writes = count->writes;
+	top[i].unit = unit;
+	top[i].reg = reg;
+}
+
+static void
+print_report(struct trace_stats *st)
+{
+	struct top_entry top[NUM_TOP];
+	uint64_t h2_total = 0, state_writes = 0, state_redundant = 0;
+	unsigned i, j;
+	double secs;
+
+	secs = (st->last_usec - st->first_usec) / 1e6;
+	printf("Buffers:       %" PRIu64 " (", st->records);
+	for (i = 0; i < ARRAY_SIZE(reason_names); i++)
+		printf("%s%s %" PRIu64, i ? ", " : "", reason_names[i],
+		       st->reasons[i]);
+	for (i = 0; i < ARRAY_SIZE(path_names); i++)
+		if (st->paths[i])
+			printf(", %s %" PRIu64, path_names[i], st->paths[i]);
+	printf(")\n");
+	printf("Command bytes: %" PRIu64 "", st->words * 4);
+	if (st->records)
+		printf(", %.1f per buffer", st->words * 4.0 / st->records);
+	if (secs > 0)
+		printf(", %.1f KB/s over %.2f s", st->words * 4 / 1024.0 / secs,
+		       secs);
+	printf("\n\n");
+
+	printf("Packet type        packets        bytes\n");
+	printf("2D (HEADER1)             - %12" PRIu64 "\n", st->h1_words * 4);
+	for (i = 0; i < 256; i++) {
+		if (!st->h2_packets[i])
+			continue;
+		h2_total += st->h2_words[i];
+		printf("%-15s %10" PRIu64 " %12" PRIu64 "\n",
+		       para_type_name(i), st->h2_packets[i],
+		       st->h2_words[i] * 4);
+	}
+	printf("padding                  - %12" PRIu64 "\n\n",
+	       (st->dummy_words + st->align_writes * 2) * 4);
+
+	printf("2D commands:   %" PRIu64, st->commands_2d);
+	if (st->commands_2d)
+		printf(", %.1f bytes each", st->h1_words * 4.0 / st->commands_2d);
+	printf("\n");
+	printf("3D draws:      %" PRIu64, st->vertex_packets);
+	if (st->vertex_packets)
+		printf(", %.1f bytes each, %.1f of them vertex data",
+		       h2_total * 4.0 / st->vertex_packets,
+		       st->vertex_words * 4.0 / st->vertex_packets);
+	printf(", %" PRIu64 " fire commands\n\n", st->fires);
+
+	memset(top, 0, sizeof(top));
+	for (i = 0; i < NUM_H1_REGS; i++) {
+		state_writes += st->h1_regs[i].writes;
+		state_redundant += st->h1_regs[i].redundant;
+		insert_top(top, &st->h1_regs[i], 0, i << 2);
+	}
+	for (i = 0; i < NUM_H2_UNITS; i++) {
+		for (j = 0; j < 256; j++) {
+			state_writes += st->h2_regs[i][j].writes;
+			state_redundant += st->h2_regs[i][j].redundant;
+			insert_top(top, &st->h2_regs[i][j], i + 1, j);
+		}
+	}
+
+	printf("Register writes: %" PRIu64 ", redundant %" PRIu64, state_writes,
+	       state_redundant);
+	if (state_writes)
+		printf(" (%.1f%%)", state_redundant * 100.0 / state_writes);
+	printf("\n");
+	for (i = 0; i < NUM_TOP && top[i].redundant; i++) {
+		if (top[i].unit == 0)
+			printf("  2D reg 0x%03x           ", top[i].reg);
+		else if (top[i].unit == 1)
+			printf("  3D SubA 0x%02x           ", top[i].reg);
+		else
+			printf("  texture %-3u SubA 0x%02x  ", top[i].unit - 2,
+			       top[i].reg);
+		printf("%10" PRIu64 " of %10" PRIu64 " redundant\n",
+		       top[i].redundant, top[i].writes);
+	}
+
+	if (st->parse_errors)
+		printf("\nParse errors: %" PRIu64 " words\n", st->parse_errors);
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-v] [-s MB] [-o file] tracefile\n"
+		"  -v       print each buffer, twice for each packet\n"
+		"  -s MB    replay the 2D commands on that much video memory\n"
+		"  -o file  write the simulated video memory to file\n", name);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct trace_stats *st;
+	ViaTraceHeader header;
+	ViaTraceRecord rec;
+	uint32_t *buf = NULL;
+	size_t bufSize = 0;
+	int verbose = 0;
+	unsigned long vram_mb = 0;
+	const char *dump = NULL;
+	FILE *file;
+	int c;
+
+	while ((c = getopt(argc, argv, "vs:o:h")) != -1) {
+		switch (c) {
+		case 'v':
+			verbose++;
+			break;
+		case 's':
+			vram_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			dump = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (optind + 1 != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[optind], "rb");
+	if (!file) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    header.magic != VIA_TRACE_MAGIC) {
+		fprintf(stderr, "%s: not a command trace\n", argv[optind]);
+		return 1;
+	}
+	if (header.version != VIA_TRACE_VERSION) {
+		fprintf(stderr, "%s: unsupported trace version %u\n",
+			argv[optind], header.version);
+		return 1;
+	}
+
+	st = calloc(1, sizeof(*st));
+	if (!st) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	if (dump && !vram_mb)
+		vram_mb = 64;
+	if (vram_mb) {
+		st->sim = sim_create(vram_mb << 20,
+				     header.flags & VIA_TRACE_2D_M1);
+		if (!st->sim) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+	}
+
+	printf("Chipset %u\n", header.chipset);
+	while (fread(&rec, sizeof(rec), 1, file) == 1) {
+		if (rec.size > bufSize) {
+			free(buf);
+			bufSize = rec.size;
+			buf = malloc(bufSize * sizeof(uint32_t));
+			if (!buf) {
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+		}
+		if (fread(buf, sizeof(uint32_t), rec.size, file) != rec.size) {
+			fprintf(stderr, "Truncated record %" PRIu64 "\n",
+				st->records);
+			break;
+		}
+
+		if (!st->records)
+			st->first_usec = rec.usec;
+		st->last_usec = rec.usec;
+		st->records++;
+		st->words += rec.size;
+		if (rec.reason < ARRAY_SIZE(st->reasons))
+			st->reasons[rec.reason]++;
+		if (rec.path < ARRAY_SIZE(st->paths))
+			st->paths[rec.path]++;
+
+		if (verbose)
+			printf("%12" PRIu64 " us: %5u words, %s, %s\n",
+			       rec.usec - st->first_usec, rec.size,
+			       rec.reason < ARRAY_SIZE(reason_names)
+			       ? reason_names[rec.reason] : "?",
+			       rec.path < ARRAY_SIZE(path_names)
+			       ? path_names[rec.path] : "?");
+
+		decode_buffer(st, buf, rec.size, verbose);
+	}
+	fclose(file);
+
+	if (verbose)
+		printf("\n");
+	print_report(st);
+
+	if (st->sim) {
+		printf("\n");
+		sim_report(st->sim, stdout);
+		if (dump) {
+			file = fopen(dump, "wb");
+			if (!file || sim_dump(st->sim, file)) {
+				fprintf(stderr, "%s: %s\n", dump, strerror(errno));
+				return 1;
+			}
+			fclose(file);
+		}
+		sim_destroy(st->sim);
+	}
+
+	free(buf);
+	free(st);
+	return 0;
+}
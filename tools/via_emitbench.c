@@ -0,0 +1,671 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmark of the command emitters of the openchrome driver. The 2D
+ * code of the VX800 and later (via_exa_h6.c) and the 3D code (via_3d.c)
+ * are linked as they are, against a stub screen whose command buffer
+ * flush only counts the words and throws them away. The workloads are
+ * the ones the CPU cost matters for: runs of glyphs, scrolls, fills and
+ * 3D state uploads. For each, the time per primitive and the command
+ * bytes per primitive are reported.
+ *
+ * With -s, the flushed command buffers are also replayed on the model of
+ * the 2D engine in via_2dsim.c. With -c, the fill and copy paths are run
+ * on that model instead of being timed, and the video memory is compared
+ * pixel by pixel with the same operations done by the CPU.
+ *
+ * The rest of the driver and the X server are not linked; the functions
+ * of theirs that the emitters refer to are stubbed at the end of this
+ * file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "via_driver.h"
+#include "pixmapstr.h"
+#include "via_2dsim.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+#define SCREEN_WIDTH	1280
+#define SCREEN_HEIGHT	1024
+#define SCREEN_PITCH	(SCREEN_WIDTH * 4)
+#define GLYPH_CACHE	0x00800000	/* Offset of the A8 glyph cache. */
+#define VRAM_SIZE	0x01000000
+
+/* Primitives per batch, between a Prepare and a Done. */
+#define GLYPHS_PER_RUN	64
+#define FILLS_PER_BATCH	16
+#define COPIES_PER_BATCH 16
+
+static ScreenRec screen;
+static ScrnInfoRec scrn;
+static VIARec via;
+static PixmapRec screenPixmap;
+static unsigned long long flushedWords;
+static unsigned long flushes;
+static struct via_2dsim *sim;
+
+/*
+ * Hand the 2D register writes of a command buffer to the 2D engine
+ * model, parsed the way viaFlushPCI writes them to the registers. The
+ * 3D packets are skipped.
+ */
+static void
+simFeed(const CARD32 *bp, const CARD32 *endp)
+{
+	CARD32 transSetting;
+
+	while (bp < endp) {
+		if (*bp == HALCYON_HEADER2) {
+			if (++bp == endp)
+				return;
+			transSetting = *bp++;
+			while (bp < endp) {
+				if (transSetting != HC_ParaType_CmdVdata &&
+				    (*bp == HALCYON_HEADER2 ||
+				     (*bp & HALCYON_HEADER1MASK) ==
+				     HALCYON_HEADER1))
+					break;
+				bp++;
+			}
+		} else if ((*bp & HALCYON_HEADER1MASK) == HALCYON_HEADER1) {
+			while (bp + 1 < endp && *bp != HALCYON_HEADER2) {
+				sim_write(sim, (bp[0] & 0x0FFFFFFF) << 2,
+					  bp[1]);
+				bp += 2;
+			}
+			if (bp + 1 == endp)
+				return;
+		} else {
+			fprintf(stderr, "Command stream parser error.\n");
+			return;
+		}
+	}
+}
+
+static void
+benchFlush(VIAPtr pVia, ViaCommandBuffer *cb)
+{
+	if (sim)
+		simFeed(cb->buf, cb->buf + cb->pos);
+	flushedWords += cb->pos;
+	flushes++;
+	cb->pos = 0;
+	cb->mode = 0;
+	cb->has3dState = FALSE;
+}
+
+static void
+benchInit(void)
+{
+	ViaCommandBuffer *cb = &via.cb;
+
+	scrn.driverPrivate = &via;
+	scrn.bitsPerPixel = 32;
+	screen.myNum = 0;
+
+	via.Chipset = VIA_VX800;
+	cb->bufSize = VIA_DMASIZE >> 2;
+	cb->buf = calloc(cb->bufSize, sizeof(CARD32));
+	if (!cb->buf) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	cb->flushFunc = benchFlush;
+	viaInit3DState(&via.v3d);
+
+	screenPixmap.drawable.pScreen = &screen;
+	screenPixmap.drawable.depth = 32;
+	screenPixmap.drawable.bitsPerPixel = 32;
+	screenPixmap.drawable.width = SCREEN_WIDTH;
+	screenPixmap.drawable.height = SCREEN_HEIGHT;
+	screenPixmap.devKind = SCREEN_PITCH;
+	screenPixmap.devPrivate.ptr = NULL;	/* Offset 0. */
+}
+
+/*
+ * Text: a solid color through the A8 glyph cache, the way EXA composites
+ * glyphs. Each glyph sets the color, uploads the changed state and emits
+ * a quad.
+ */
+static void
+benchGlyphs(unsigned long batches)
+{
+	Via3DState *v3d = &via.v3d;
+	CARD32 color = 0xff102030;
+	unsigned long i;
+	int j;
+
+	for (i = 0; i < batches; i++) {
+		via.compositeFill = FALSE;
+		via.dstFormat = PICT_a8r8g8b8;
+		via.srcP = &color;
+		via.srcFormat = PICT_a8r8g8b8;
+		via.maskP = NULL;
+		v3d->setDestination(v3d, 0, SCREEN_PITCH, PICT_a8r8g8b8);
+		v3d->setCompositeOperator(v3d, PictOpOver);
+		v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x000000FF, 0xFF);
+		v3d->setTexture(v3d, 0, GLYPH_CACHE, 1024, FALSE, 1024, 256,
+				PICT_a8, via_repeat, via_repeat, via_mask,
+				FALSE);
+		v3d->setTexTransform(v3d, 0, NULL, FALSE);
+		v3d->setFlags(v3d, 1, FALSE, TRUE, TRUE);
+		v3d->emitState(&via, v3d, &via.cb, 0);
+		v3d->emitClipRect(&via, v3d, &via.cb, 0, 0, SCREEN_WIDTH,
+				  SCREEN_HEIGHT);
+
+		for (j = 0; j < GLYPHS_PER_RUN; j++)
+			viaExaComposite_H6(&screenPixmap, 0, 0,
+					   (j % 128) * 8, (j / 128) * 16,
+					   8 + j * 8, 100, 8, 16);
+		viaExaDoneComposite_H6(&screenPixmap);
+	}
+}
+
+/* Scrolling a maximized terminal up by a line: one large copy. */
+static void
+benchScroll(unsigned long batches)
+{
+	unsigned long i;
+
+	for (i = 0; i < batches; i++) {
+		viaExaPrepareCopy_H6(&screenPixmap, &screenPixmap, 1, 1,
+				     GXcopy, 0xFFFFFFFF);
+		viaExaCopy_H6(&screenPixmap, 0, 16, 0, 0, SCREEN_WIDTH,
+			      SCREEN_HEIGHT - 16);
+		viaExaDoneSolidCopy_H6(&screenPixmap);
+	}
+}
+
+/* Moving a window over others: a copy per clip rectangle. */
+static void
+benchCopies(unsigned long batches)
+{
+	unsigned long i;
+	int j;
+
+	for (i = 0; i < batches; i++) {
+		viaExaPrepareCopy_H6(&screenPixmap, &screenPixmap, -1, -1,
+				     GXcopy, 0xFFFFFFFF);
+		for (j = 0; j < COPIES_PER_BATCH; j++)
+			viaExaCopy_H6(&screenPixmap, 100 + j * 16, 100,
+				      104 + j * 16, 102, 16, 300);
+		viaExaDoneSolidCopy_H6(&screenPixmap);
+	}
+}
+
+/* Backgrounds and widgets: a batch of solid fills. */
+static void
+benchFills(unsigned long batches)
+{
+	unsigned long i;
+	int j;
+
+	for (i = 0; i < batches; i++) {
+		viaExaPrepareSolid_H6(&screenPixmap, GXcopy, 0xFFFFFFFF,
+				      0x00c0c0c0);
+		for (j = 0; j < FILLS_PER_BATCH; j++)
+			viaExaSolid_H6(&screenPixmap, j * 20, 40,
+				       j * 20 + 18, 60);
+		viaExaDoneSolidCopy_H6(&screenPixmap);
+	}
+}
+
+/* A full 3D state upload, as after a DRI client used the engine. */
+static void
+benchState(unsigned long batches)
+{
+	Via3DState *v3d = &via.v3d;
+	unsigned long i;
+
+	v3d->setDestination(v3d, 0, SCREEN_PITCH, PICT_a8r8g8b8);
+	v3d->setCompositeOperator(v3d, PictOpOver);
+	v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x000000FF, 0xFF);
+	v3d->setTexture(v3d, 0, GLYPH_CACHE, 1024, FALSE, 1024, 256, PICT_a8,
+			via_repeat, via_repeat, via_mask, FALSE);
+	v3d->setFlags(v3d, 1, FALSE, TRUE, TRUE);
+
+	for (i = 0; i < batches; i++) {
+		v3d->emitState(&via, v3d, &via.cb, VIA_3D_STATE_ALL);
+		via.cb.flushFunc(&via, &via.cb);
+	}
+}
+
+/* Expansion of one-pixel sources in the common formats. */
+static void
+benchPixel(unsigned long batches)
+{
+	static const struct {
+		unsigned format;
+		CARD32 pixel;
+	} pixels[] = {
+		{ PICT_a8r8g8b8, 0x80402010 },
+		{ PICT_x8r8g8b8, 0x00402010 },
+		{ PICT_r5g6b5, 0x4208 },
+		{ PICT_a8, 0x80 },
+	};
+	volatile CARD32 sink = 0;
+	CARD32 argb;
+	unsigned long i;
+	unsigned j;
+
+	for (i = 0; i < batches; i++) {
+		for (j = 0; j < ARRAY_SIZE(pixels); j++) {
+			CARD32 pixel = pixels[j].pixel;
+
+			viaPixelARGB8888(pixels[j].format, &pixel, &argb);
+			sink += argb;
+		}
+	}
+	(void)sink;
+}
+
+/*
+ * Pixel checks on the 2D engine model. The screen gets a pattern, and a
+ * copy of it is kept as the reference that the CPU draws into.
+ */
+static CARD32 reference[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+static CARD32 *
+simScreen(void)
+{
+	return (CARD32 *)sim_vram(sim);
+}
+
+static void
+checkReset(void)
+{
+	CARD32 *screen = simScreen();
+	CARD32 seed = 1;
+	int i;
+
+	for (i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+		seed = seed * 1103515245 + 12345;
+		reference[i] = seed ^ (seed >> 16);
+	}
+	memcpy(screen, reference, sizeof(reference));
+}
+
+static int
+checkCompare(const char *name)
+{
+	CARD32 *screen = simScreen();
+	int i, bad = 0;
+
+	for (i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+		if (screen[i] == reference[i])
+			continue;
+		if (!bad)
+			printf("%-16s pixel %d,%d: 0x%08x, expected 0x%08x\n",
+			       name, i % SCREEN_WIDTH, i / SCREEN_WIDTH,
+			       (unsigned)screen[i], (unsigned)reference[i]);
+		bad++;
+	}
+	printf("%-16s %s", name, bad ? "FAILED" : "ok");
+	if (bad)
+		printf(", %d pixels differ", bad);
+	printf("\n");
+	return bad != 0;
+}
+
+static int
+checkFill(const char *name, int alu, CARD32 planeMask, CARD32 fg,
+	  int x1, int y1, int x2, int y2)
+{
+	CARD32 *d;
+	CARD32 value;
+	int x, y;
+
+	checkReset();
+	if (!viaExaPrepareSolid_H6(&screenPixmap, alu, planeMask, fg)) {
+		printf("%-16s not accelerated\n", name);
+		return 1;
+	}
+	viaExaSolid_H6(&screenPixmap, x1, y1, x2, y2);
+	viaExaDoneSolidCopy_H6(&screenPixmap);
+
+	for (y = y1; y < y2; y++) {
+		for (x = x1; x < x2; x++) {
+			d = &reference[y * SCREEN_WIDTH + x];
+			value = (alu == GXxor) ? (*d ^ fg) : fg;
+			*d = (value & planeMask) | (*d & ~planeMask);
+		}
+	}
+	return checkCompare(name);
+}
+
+/* Copies within the screen, in the directions EXA would pick. */
+static int
+checkCopy(const char *name, int sx, int sy, int dx, int dy, int w, int h)
+{
+	static CARD32 tmp[SCREEN_WIDTH * SCREEN_HEIGHT];
+	int y;
+
+	checkReset();
+	if (!viaExaPrepareCopy_H6(&screenPixmap, &screenPixmap,
+				  (sx < dx) ? -1 : 1, (sy < dy) ? -1 : 1,
+				  GXcopy, 0xFFFFFFFF)) {
+		printf("%-16s not accelerated\n", name);
+		return 1;
+	}
+	viaExaCopy_H6(&screenPixmap, sx, sy, dx, dy, w, h);
+	viaExaDoneSolidCopy_H6(&screenPixmap);
+
+	for (y = 0; y < h; y++)
+		memcpy(tmp + y * w, &reference[(sy + y) * SCREEN_WIDTH + sx],
+		       w * 4);
+	for (y = 0; y < h; y++)
+		memcpy(&reference[(dy + y) * SCREEN_WIDTH + dx], tmp + y * w,
+		       w * 4);
+	return checkCompare(name);
+}
+
+static int
+runChecks(void)
+{
+	int failed = 0;
+
+	failed += checkFill("fill", GXcopy, 0xFFFFFFFF, 0x00c0c0c0,
+			    20, 40, 300, 60);
+	failed += checkFill("fill xor", GXxor, 0xFFFFFFFF, 0x00ff00ff,
+			    1, 1, 2, 700);
+	failed += checkFill("fill planemask", GXcopy, 0x00FFFFFF, 0x80102030,
+			    100, 100, 612, 356);
+	failed += checkCopy("copy right", 100, 100, 104, 102, 300, 200);
+	failed += checkCopy("copy left", 104, 102, 100, 100, 300, 200);
+	failed += checkCopy("copy up right", 100, 300, 140, 200, 16, 300);
+	failed += checkCopy("copy apart", 0, 0, 640, 512, 640, 512);
+	failed += checkCopy("scroll", 0, 16, 0, 0, SCREEN_WIDTH,
+			    SCREEN_HEIGHT - 16);
+
+	sim_report(sim, stdout);
+	return failed;
+}
+
+static const struct workload {
+	const char *name;
+	void (*run)(unsigned long batches);
+	unsigned primitives;	/* Per batch. */
+	const char *unit;
+} workloads[] = {
+	{ "glyphs", benchGlyphs, GLYPHS_PER_RUN, "glyph" },
+	{ "scroll", benchScroll, 1, "scroll" },
+	{ "copies", benchCopies, COPIES_PER_BATCH, "copy" },
+	{ "fills", benchFills, FILLS_PER_BATCH, "fill" },
+	{ "state", benchState, 1, "upload" },
+	{ "pixel", benchPixel, 4, "pixel" },
+};
+
+static double
+nowNsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+runWorkload(const struct workload *w, unsigned long batches)
+{
+	unsigned long long prims = (unsigned long long)batches * w->primitives;
+	double start, nsec;
+
+	/* Warm the caches and the branch predictors first. */
+	w->run(batches / 10 + 1);
+
+	if (sim)
+		simFeed(via.cb.buf, via.cb.buf + via.cb.pos);
+	via.cb.pos = 0;
+	flushedWords = 0;
+	flushes = 0;
+	start = nowNsec();
+	w->run(batches);
+	nsec = nowNsec() - start;
+	flushedWords += via.cb.pos;
+	if (sim)
+		simFeed(via.cb.buf, via.cb.buf + via.cb.pos);
+	via.cb.pos = 0;
+
+	printf("%-8s %10llu %-7s %9.1f ns %9.1f bytes %8lu flushes\n",
+	       w->name, prims, w->unit, nsec / prims,
+	       flushedWords * 4.0 / prims, flushes);
+}
+
+static void
+usage(const char *name)
+{
+	unsigned i;
+
+	fprintf(stderr, "Usage: %s [-n batches] [-s] [workload...]\n"
+		"       %s -c\n"
+		"  -n N     batches of primitives per workload, default 100000\n"
+		"  -s       also run the 2D commands on the 2D engine model\n"
+		"  -c       check the fills and copies on the model pixel by "
+		"pixel\n"
+		"Workloads:", name, name);
+	for (i = 0; i < ARRAY_SIZE(workloads); i++)
+		fprintf(stderr, " %s", workloads[i].name);
+	fprintf(stderr, "\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned long batches = 100000;
+	int simulate = 0, check = 0;
+	unsigned i;
+	int c, j;
+
+	while ((c = getopt(argc, argv, "n:sch")) != -1) {
+		switch (c) {
+		case 'n':
+			batches = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			simulate = 1;
+			break;
+		case 'c':
+			check = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (!batches) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	benchInit();
+	if (simulate || check) {
+		sim = sim_create(VRAM_SIZE, 1);
+		if (!sim) {
+			fprintf(stderr, "Out of memory.\n");
+			return 1;
+		}
+	}
+	if (check)
+		return runChecks() ? 1 : 0;
+
+	printf("%-8s %10s %-7s %12s %15s\n", "workload", "primitives", "",
+	       "time", "commands");
+
+	if (optind == argc) {
+		for (i = 0; i < ARRAY_SIZE(workloads); i++)
+			runWorkload(&workloads[i], batches);
+	}
+
+	for (j = optind; j < argc; j++) {
+		for (i = 0; i < ARRAY_SIZE(workloads); i++) {
+			if (!strcmp(argv[j], workloads[i].name))
+				break;
+		}
+		if (i == ARRAY_SIZE(workloads)) {
+			fprintf(stderr, "Unknown workload %s.\n", argv[j]);
+			usage(argv[0]);
+			return 1;
+		}
+		runWorkload(&workloads[i], batches);
+	}
+
+	if (sim)
+		sim_report(sim, stdout);
+	return 0;
+}
+
+/*
+ * Stubs for the X server and the rest of the driver. The pixmap offset is
+ * kept in devPrivate.ptr.
+ */
+
+#ifdef xf86ScreenToScrn
+ScrnInfoPtr *xf86Screens = (ScrnInfoPtr[]) { &scrn };
+#else
+ScrnInfoPtr
+xf86ScreenToScrn(ScreenPtr pScreen)
+{
+	return &scrn;
+}
+#endif
+
+unsigned long
+exaGetPixmapOffset(PixmapPtr pPix)
+{
+	return (unsigned long)pPix->devPrivate.ptr;
+}
+
+unsigned long
+exaGetPixmapPitch(PixmapPtr pPix)
+{
+	return pPix->devKind;
+}
+
+void
+ErrorF(const char *f, ...)
+{
+	va_list args;
+
+	va_start(args, f);
+	vfprintf(stderr, f, args);
+	va_end(args);
+}
+
+Bool
+viaAccelSetMode(int bpp, ViaTwodContext *tdc)
+{
+	switch (bpp) {
+	case 16:
+		tdc->mode = VIA_GEM_16bpp;
+		tdc->bytesPPShift = 1;
+		return TRUE;
+	case 32:
+		tdc->mode = VIA_GEM_32bpp;
+		tdc->bytesPPShift = 2;
+		return TRUE;
+	case 8:
+		tdc->mode = VIA_GEM_8bpp;
+		tdc->bytesPPShift = 0;
+		return TRUE;
+	default:
+		tdc->bytesPPShift = 0;
+		return FALSE;
+	}
+}
+
+CARD32
+viaCheckUpload(ScrnInfoPtr pScrn, Via3DState *v3d)
+{
+	return 0;
+}
+
+/* Not reached by the workloads. */
+
+Bool
+viaOrder(CARD32 val, CARD32 *shift)
+{
+	*shift = 0;
+	while (val > (1 << *shift))
+		(*shift)++;
+	return (val == (1 << *shift));
+}
+
+Bool
+viaIsAGP(VIAPtr pVia, PixmapPtr pPix, unsigned long *offset)
+{
+	return FALSE;
+}
+
+Bool
+viaExaIsOffscreen(PixmapPtr pPix)
+{
+	return TRUE;
+}
+
+Bool
+viaExpandablePixel(int format)
+{
+	return FALSE;
+}
+
+Bool
+viaExaCheckCompositeA8(int op, PicturePtr pSrcPicture,
+		       PicturePtr pMaskPicture, PicturePtr pDstPicture)
+{
+	return FALSE;
+}
+
+void
+viaExaCompositeA8(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
+		  int dstX, int dstY, int width, int height)
+{
+}
+
+void
+viaExaCompositeReject(VIAPtr pVia, int reason, CARD8 op, PicturePtr pSrc,
+		      PicturePtr pMask, PicturePtr pDst)
+{
+}
+
+Bool
+viaExaCompositeFillColor(CARD8 op, PicturePtr pSrcPicture, void *srcP,
+			 PicturePtr pDstPicture, Pixel *fg)
+{
+	return FALSE;
+}
+
+void
+viaExaCompositeTiled(PixmapPtr pDst, int srcX, int srcY, int maskX,
+		     int maskY, int dstX, int dstY, int width, int height)
+{
+}
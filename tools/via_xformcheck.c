@@ -0,0 +1,366 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check of the transformed texture coordinates the 3D code of the
+ * openchrome driver (via_3d.c) emits for composites. A repeating source
+ * and mask are set up with a set of affine transforms, a quad is
+ * emitted, and the vertices are read back from the command buffer. The
+ * two triangles are then rasterized the way the 3D engine samples them,
+ * with nearest filtering and wrapping texture coordinates, and the
+ * result is compared with what pixman renders for the same pictures.
+ * Before that, the pictures the 3D code must turn down are checked.
+ *
+ * Pixels whose sample lands exactly on a texel edge are skipped, since
+ * the hardware and pixman round those differently. Bilinear filtering
+ * is not checked.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <pixman.h>
+
+#include "via_driver.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+#define TEX_SIZE	64	/* Power of two, so that the texture wraps. */
+#define DST_WIDTH	97
+#define DST_HEIGHT	61
+#define EDGE_EPSILON	1e-3
+
+static VIARec via;
+static CARD32 texels[2][TEX_SIZE * TEX_SIZE];
+
+struct xform {
+	const char *name;
+	double m[2][3];
+	int srcX, srcY;
+};
+
+static const struct xform xforms[] = {
+	{ "translate", { { 1, 0, 5 }, { 0, 1, -3 } }, 0, 0 },
+	{ "offset", { { 1, 0, 0 }, { 0, 1, 0 } }, 17, 9 },
+	{ "scale up", { { 0.5, 0, 0.1 }, { 0, 0.25, 0.1 } }, 3, 7 },
+	{ "scale down", { { 2, 0, 0.4 }, { 0, 3, 0.2 } }, 0, 0 },
+	{ "flip", { { -1, 0, 63 }, { 0, 1, 0 } }, 0, 0 },
+	{ "rotate 30", { { 0.866025, -0.5, 11 }, { 0.5, 0.866025, -7 } }, 4, 2 },
+	{ "rotate 90", { { 0, -1, 40 }, { 1, 0, 0 } }, 0, 0 },
+	{ "shear", { { 1, 0.3, 0 }, { 0.2, 1, 0 } }, 13, 21 },
+};
+
+static void
+checkFlush(VIAPtr pVia, ViaCommandBuffer *cb)
+{
+	cb->pos = 0;
+	cb->mode = 0;
+	cb->has3dState = FALSE;
+}
+
+static void
+checkInit(void)
+{
+	ViaCommandBuffer *cb = &via.cb;
+	unsigned i, t;
+
+	via.Chipset = VIA_VX800;
+	cb->bufSize = VIA_DMASIZE >> 2;
+	cb->buf = calloc(cb->bufSize, sizeof(CARD32));
+	if (!cb->buf) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	cb->flushFunc = checkFlush;
+	viaInit3DState(&via.v3d);
+
+	srand(1);
+	for (t = 0; t < 2; t++)
+		for (i = 0; i < TEX_SIZE * TEX_SIZE; i++)
+			texels[t][i] = ((CARD32)rand() << 16) ^ rand();
+}
+
+static void
+toPixman(const struct xform *x, pixman_transform_t *t)
+{
+	int i, j;
+
+	memset(t, 0, sizeof(*t));
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < 3; j++)
+			t->matrix[i][j] = pixman_double_to_fixed(x->m[i][j]);
+	t->matrix[2][2] = pixman_fixed_1;
+}
+
+/* What pixman draws for one texture unit: the reference. */
+static void
+renderPixman(int tex, const struct xform *x, CARD32 *dst)
+{
+	pixman_image_t *src, *dimg;
+	pixman_transform_t t;
+
+	src = pixman_image_create_bits(PIXMAN_a8r8g8b8, TEX_SIZE, TEX_SIZE,
+				       (uint32_t *)texels[tex], TEX_SIZE * 4);
+	dimg = pixman_image_create_bits(PIXMAN_a8r8g8b8, DST_WIDTH,
+					DST_HEIGHT, (uint32_t *)dst,
+					DST_WIDTH * 4);
+	toPixman(x, &t);
+	pixman_image_set_transform(src, &t);
+	pixman_image_set_repeat(src, PIXMAN_REPEAT_NORMAL);
+	pixman_image_set_filter(src, PIXMAN_FILTER_NEAREST, NULL, 0);
+	pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, dimg,
+				 x->srcX, x->srcY, 0, 0, 0, 0,
+				 DST_WIDTH, DST_HEIGHT);
+	pixman_image_unref(src);
+	pixman_image_unref(dimg);
+}
+
+struct vertex {
+	float x, y;
+	float s[VIA_NUM_TEXUNITS], t[VIA_NUM_TEXUNITS];
+};
+
+/*
+ * Find the six vertices of the quad in the command buffer. They follow
+ * the vertex format and the primitive setting.
+ */
+static int
+readVertices(ViaCommandBuffer *cb, int numTex, struct vertex *v)
+{
+	CARD32 prim = (0xEE << HC_SubA_SHIFT) | ((2 << 16) & HC_Para_MASK);
+	float *f;
+	unsigned i;
+	int n, j;
+
+	for (i = 0; i < cb->pos; i++)
+		if (cb->buf[i] == prim)
+			break;
+	if (i + 6 * (3 + 2 * numTex) > cb->pos)
+		return 0;
+
+	f = (float *)(cb->buf + i + 1);
+	for (n = 0; n < 6; n++) {
+		v[n].x = *f++;
+		v[n].y = *f++;
+		f++;	/* W */
+		for (j = 0; j < numTex; j++) {
+			v[n].s[j] = *f++;
+			v[n].t[j] = *f++;
+		}
+	}
+	return 1;
+}
+
+static double
+edge(const struct vertex *a, const struct vertex *b, double x, double y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+/*
+ * Sample texture unit tex at the pixel center (x, y) of the triangle v.
+ * Returns FALSE if the pixel is outside the triangle. A sample that
+ * cannot be told from its neighbouring texel is marked ambiguous.
+ */
+static Bool
+sampleTriangle(const struct vertex *v, int tex, double x, double y,
+	       CARD32 *texel, Bool *ambiguous)
+{
+	double area, w0, w1, w2, s, t;
+	int u, w;
+
+	area = edge(v, v + 1, v[2].x, v[2].y);
+	if (area == 0)
+		return FALSE;
+	w0 = edge(v + 1, v + 2, x, y) / area;
+	w1 = edge(v + 2, v, x, y) / area;
+	w2 = edge(v, v + 1, x, y) / area;
+	if (w0 < -1e-9 || w1 < -1e-9 || w2 < -1e-9)
+		return FALSE;
+
+	s = (w0 * v[0].s[tex] + w1 * v[1].s[tex] + w2 * v[2].s[tex]) *
+	    TEX_SIZE;
+	t = (w0 * v[0].t[tex] + w1 * v[1].t[tex] + w2 * v[2].t[tex]) *
+	    TEX_SIZE;
+
+	*ambiguous = (fabs(s - floor(s + 0.5)) < EDGE_EPSILON) ||
+		     (fabs(t - floor(t + 0.5)) < EDGE_EPSILON);
+
+	u = (int)floor(s) & (TEX_SIZE - 1);
+	w = (int)floor(t) & (TEX_SIZE - 1);
+	*texel = texels[tex][w * TEX_SIZE + u];
+	return TRUE;
+}
+
+static int
+checkXform(const struct xform *x, const struct xform *maskX)
+{
+	Via3DState *v3d = &via.v3d;
+	static CARD32 ref[2][DST_WIDTH * DST_HEIGHT];
+	const struct xform *unit[2] = { x, maskX };
+	pixman_transform_t t[2];
+	struct vertex v[6];
+	CARD32 texel;
+	Bool ambiguous;
+	int tex, px, py, tri, bad = 0, missed = 0, skipped = 0;
+
+	for (tex = 0; tex < 2; tex++) {
+		toPixman(unit[tex], &t[tex]);
+		v3d->setTexture(v3d, tex, 0, TEX_SIZE * 4, FALSE, TEX_SIZE,
+				TEX_SIZE, PICT_a8r8g8b8, via_repeat,
+				via_repeat, tex ? via_mask : via_src, FALSE);
+		v3d->setTexTransform(v3d, tex, &t[tex], FALSE);
+		renderPixman(tex, unit[tex], ref[tex]);
+	}
+	v3d->setFlags(v3d, 2, FALSE, TRUE, TRUE);
+
+	via.cb.pos = 0;
+	via.cb.mode = 0;
+	via.cb.has3dState = TRUE;
+	v3d->emitQuad(&via, v3d, &via.cb, 0, 0, x->srcX, x->srcY,
+		      maskX->srcX, maskX->srcY, DST_WIDTH, DST_HEIGHT);
+	if (!readVertices(&via.cb, 2, v)) {
+		printf("%-12s no vertices emitted\n", x->name);
+		return 1;
+	}
+
+	for (py = 0; py < DST_HEIGHT; py++) {
+		for (px = 0; px < DST_WIDTH; px++) {
+			for (tex = 0; tex < 2; tex++) {
+				for (tri = 0; tri < 2; tri++)
+					if (sampleTriangle(v + tri * 3, tex,
+							   px + 0.5, py + 0.5,
+							   &texel, &ambiguous))
+						break;
+				if (tri == 2) {
+					missed++;
+					continue;
+				}
+				if (ambiguous) {
+					skipped++;
+					continue;
+				}
+				if (texel != ref[tex][py * DST_WIDTH + px]) {
+					if (!bad)
+						printf("%-12s unit %d pixel "
+						       "%d,%d: 0x%08x, pixman "
+						       "0x%08x\n", x->name,
+						       tex, px, py,
+						       (unsigned)texel,
+						       (unsigned)ref[tex]
+						       [py * DST_WIDTH + px]);
+					bad++;
+				}
+			}
+		}
+	}
+
+	printf("%-12s %6d pixels differ, %d not drawn, %d skipped\n",
+	       x->name, bad, missed, skipped);
+	return (bad + missed) != 0;
+}
+
+/*
+ * Pictures the composite checks must turn down: a solid or gradient
+ * picture has no drawable, and a transformed picture must repeat and
+ * have power of two sizes.
+ */
+static int
+checkSupport(void)
+{
+	static const struct {
+		const char *name;
+		Bool drawable, repeat;
+		int width, height;
+		Bool supported;
+	} cases[] = {
+		{ "repeating", TRUE, TRUE, TEX_SIZE, TEX_SIZE, TRUE },
+		{ "no repeat", TRUE, FALSE, TEX_SIZE, TEX_SIZE, FALSE },
+		{ "odd size", TRUE, TRUE, TEX_SIZE, DST_HEIGHT, FALSE },
+		{ "no drawable", FALSE, TRUE, 0, 0, FALSE },
+	};
+	Via3DState *v3d = &via.v3d;
+	pixman_transform_t t;
+	PictureRec pict;
+	DrawableRec draw;
+	unsigned i;
+	int failed = 0;
+	Bool ret;
+
+	toPixman(&xforms[0], &t);
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		memset(&pict, 0, sizeof(pict));
+		memset(&draw, 0, sizeof(draw));
+		draw.width = cases[i].width;
+		draw.height = cases[i].height;
+		pict.pDrawable = cases[i].drawable ? &draw : NULL;
+		pict.repeat = cases[i].repeat;
+		pict.repeatType = RepeatNormal;
+		pict.filter = PictFilterNearest;
+		pict.transform = &t;
+
+		ret = v3d->transformSupported(&pict);
+		if (ret != cases[i].supported) {
+			printf("%-12s transform %s, expected %s\n",
+			       cases[i].name, ret ? "accepted" : "rejected",
+			       cases[i].supported ? "accepted" : "rejected");
+			failed++;
+		}
+	}
+	return failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned i;
+	int failed = 0;
+
+	checkInit();
+	failed += checkSupport();
+
+	/* The mask always uses the next transform, to keep the units apart. */
+	for (i = 0; i < ARRAY_SIZE(xforms); i++)
+		failed += checkXform(&xforms[i],
+				     &xforms[(i + 1) % ARRAY_SIZE(xforms)]);
+
+	if (failed)
+		printf("%d checks failed.\n", failed);
+	return failed ? 1 : 0;
+}
+
+/* Stub for the X server. */
+
+void
+ErrorF(const char *f, ...)
+{
+	va_list args;
+
+	va_start(args, f);
+	vfprintf(stderr, f, args);
+	va_end(args);
+}